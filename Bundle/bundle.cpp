@@ -0,0 +1,145 @@
+/* riban plugins - all riban plugins in a single LV2 bundle
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*  Each plugin is compiled with DPF's DistrhoPluginMain.cpp within its own namespace and with its
+    LV2 entry points renamed riban<Name>_lv2_descriptor and riban<Name>_lv2_generate_ttl (see
+    Makefile). This file provides the entry points of the shared object, which index those of each
+    plugin, so that a host loads one object for all riban plugins.
+*/
+
+#include "lv2/lv2.h"
+
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Entry points of each plugin, renamed when compiling its DistrhoPluginMain.cpp
+#define DECLARE_PLUGIN(name)                                                            \
+    extern "C" const LV2_Descriptor* riban##name##_lv2_descriptor(uint32_t index); \
+    extern "C" void riban##name##_lv2_generate_ttl(const char* basename);
+
+DECLARE_PLUGIN(MultiChord)
+DECLARE_PLUGIN(MultiChordMap)
+DECLARE_PLUGIN(Chordulator)
+DECLARE_PLUGIN(TonalChord)
+DECLARE_PLUGIN(CCSend)
+
+struct bundle_plugin {
+    const char* name; // Plugin binary name, used as directory of plugin's turtle files
+    const LV2_Descriptor* (*descriptor)(uint32_t index); // Plugin's lv2_descriptor
+    void (*generateTtl)(const char* basename); // Plugin's lv2_generate_ttl
+};
+
+#define PLUGIN_ENTRY(name) {"riban" #name, riban##name##_lv2_descriptor, riban##name##_lv2_generate_ttl}
+
+static const bundle_plugin s_plugins[] = {
+    PLUGIN_ENTRY(MultiChord),
+    PLUGIN_ENTRY(MultiChordMap),
+    PLUGIN_ENTRY(Chordulator),
+    PLUGIN_ENTRY(TonalChord),
+    PLUGIN_ENTRY(CCSend)
+};
+
+static const uint32_t s_pluginCount = sizeof(s_plugins) / sizeof(bundle_plugin);
+
+// Each DPF plugin provides a single descriptor (index 0)
+LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor(uint32_t index) {
+    if (index >= s_pluginCount)
+        return nullptr;
+    return s_plugins[index].descriptor(0);
+}
+
+// Read a whole text file. Returns empty string if file cannot be read.
+static std::string readFile(const char* path) {
+    std::string text;
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return text;
+    char buffer[4096];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, len);
+    fclose(file);
+    return text;
+}
+
+// Get the path within <> on a line. Returns empty string if line has no path.
+static std::string getPath(const std::string& line) {
+    size_t start = line.find('<');
+    size_t end   = line.find('>', start);
+    if (start == std::string::npos || end == std::string::npos)
+        return std::string();
+    return line.substr(start + 1, end - start - 1);
+}
+
+// Replace the path within <> on a line
+static std::string replacePath(const std::string& line, const std::string& path) {
+    size_t start = line.find('<');
+    size_t end   = line.find('>', start);
+    if (start == std::string::npos || end == std::string::npos)
+        return line;
+    return line.substr(0, start + 1) + path + line.substr(end);
+}
+
+/*  Called by DPF's lv2_ttl_generator with the current directory set to the bundle. Each plugin
+    writes its turtle files (which have the same names for some plugins, e.g. presets.ttl) to its
+    own subdirectory. Each plugin's manifest is then merged into the bundle's manifest, pointing
+    lv2:binary at this shared object and rdfs:seeAlso at the subdirectory.
+*/
+LV2_SYMBOL_EXPORT void lv2_generate_ttl(const char* basename) {
+    std::string manifest;
+    for (uint32_t i = 0; i < s_pluginCount; ++i) {
+        const bundle_plugin& plugin = s_plugins[i];
+        mkdir(plugin.name, 0755);
+        if (chdir(plugin.name) != 0) {
+            fprintf(stderr, "Failed to create directory %s\n", plugin.name);
+            continue;
+        }
+        plugin.generateTtl(plugin.name);
+        std::string text = readFile("manifest.ttl");
+        remove("manifest.ttl");
+        if (chdir("..") != 0)
+            return;
+        size_t start  = 0;
+        bool seeAlso  = false; // True if line continues a list of rdfs:seeAlso paths
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos)
+                end = text.size();
+            std::string line = text.substr(start, end - start);
+            start            = end + 1;
+            if (line.compare(0, 7, "@prefix") == 0 && manifest.find(line) != std::string::npos)
+                continue; // Prefix already declared by a previous plugin
+            if (line.find("lv2:binary") != std::string::npos) {
+                std::string path = getPath(line);
+                size_t dot       = path.rfind('.');
+                line             = replacePath(line, basename + (dot == std::string::npos ? std::string() : path.substr(dot)));
+            } else if (line.find("rdfs:seeAlso") != std::string::npos || (seeAlso && line.find_first_not_of(' ') == line.find('<'))) {
+                line = replacePath(line, std::string(plugin.name) + "/" + getPath(line));
+                seeAlso = line.find_last_not_of(' ') == line.rfind(',');
+            }
+            manifest += line + "\n";
+        }
+    }
+    FILE* file = fopen("manifest.ttl", "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write manifest.ttl\n");
+        return;
+    }
+    fputs(manifest.c_str(), file);
+    fclose(file);
+    printf("Wrote manifest.ttl for %u plugins\n", s_pluginCount);
+}
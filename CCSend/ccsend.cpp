@@ -14,10 +14,29 @@
  */
 
 #include "DistrhoPlugin.hpp"
+#include "EnumTables.hpp"
+#include "MidiOutQueue.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 
 START_NAMESPACE_DISTRHO
 
 #define NUM_CC 8 // 0..127 (0 to disable CC. 128 gives invalid default value but could be used.)
+#define PARAM_EVENT_QUEUE_SIZE 1024 // Maximum quantity of MIDI events from parameter changes waiting for run() (power of 2)
+#define MAX_CC_RATE 1000 // Maximum value of CC rate limit (events per second)
+#define DIN_BYTES_PER_SECOND 3125.0 // 31250 baud serial MIDI, 10 bits per byte
+#define NO_CONTROL 0xFF // Parameter event that is not from a CC control so may not be coalesced
+#define MAX_HIGH_RES 16383 // Maximum value of 14-bit CC, NRPN and RPN
+#define HIGH_RES_KEY (16 * 128) // Pending CC index of first high resolution control (one per control after one per channel and CC number)
+#define NUM_PENDING (HIGH_RES_KEY + NUM_CC) // Quantity of pending CC slots
+#define NUM_SCENES 8 // Quantity of scene snapshots
+#define SCENE_RECALL 0xFE // Parameter event that starts sending a recalled scene
+#define FEEDBACK_LSB 0x80 // Flag in feedback map indicating LSB of a 14-bit CC control
+#define THRU_BLOCK 0x80 // Value in thru CC map that blocks the CC
 
 enum BANK_MODES {
     BS_SEND_BS     = 0, // Only send Bank Select LSB or MSB
@@ -26,10 +45,35 @@ enum BANK_MODES {
     BS_SEND_ALL    = 3  // Send BS LSB and MSB followed by PC
 };
 
+enum CC_MODES {
+    CC_MODE_7BIT  = 0, // Single CC with 7-bit value
+    CC_MODE_14BIT = 1, // CC 0..31 (MSB) paired with CC 32..63 (LSB)
+    CC_MODE_NRPN  = 2, // Non-registered parameter number (CC 99/98) with data entry (CC 6/38)
+    CC_MODE_RPN   = 3  // Registered parameter number (CC 101/100) with data entry (CC 6/38)
+};
+
+enum FEEDBACK_MODES {
+    FEEDBACK_OFF,   // Incoming CCs are passed thru without updating controls
+    FEEDBACK_THRU,  // Incoming CCs update matching controls and are passed thru
+    FEEDBACK_ABSORB // Incoming CCs update matching controls and are not passed thru
+};
+
+enum THRU_TYPES {
+    THRU_NOTE,          // Note off and note on
+    THRU_POLY_PRESSURE, // Polyphonic key pressure
+    THRU_CC,            // Control change
+    THRU_PROGRAM,       // Program change
+    THRU_CHAN_PRESSURE, // Channel pressure
+    THRU_PITCH_BEND,    // Pitch bend
+    THRU_SYSTEM,        // System exclusive, common and real-time
+    NUM_THRU_TYPES
+};
+
 enum GROUP_IDS {
     GROUP_ID_CC,
     GROUP_ID_PROG,
-    GROUP_ID_CONFIG
+    GROUP_ID_CONFIG,
+    GROUP_ID_THRU
 };
 
 enum PARM_IDS {
@@ -40,7 +84,20 @@ enum PARM_IDS {
     PARAM_ID_GLOBAL_CHAN =  PARAM_ID_CC + NUM_CC,
     PARAM_ID_CC_CHAN,
     PARAM_ID_CC_NUM = PARAM_ID_CC_CHAN + NUM_CC,
-    PARAM_ID_BS_MODE = PARAM_ID_CC_NUM + NUM_CC
+    PARAM_ID_BS_MODE = PARAM_ID_CC_NUM + NUM_CC,
+    PARAM_ID_CC_RATE,
+    PARAM_ID_DIN_LIMIT = PARAM_ID_CC_RATE + NUM_CC,
+    PARAM_ID_DROPPED,
+    PARAM_ID_CC_MODE,
+    PARAM_ID_CC_PARAM = PARAM_ID_CC_MODE + NUM_CC,
+    PARAM_ID_SCENE = PARAM_ID_CC_PARAM + NUM_CC,
+    PARAM_ID_SCENE_STORE,
+    PARAM_ID_SCENE_RATE,
+    PARAM_ID_FEEDBACK,
+    PARAM_ID_CC_VALUE,
+    PARAM_ID_THRU_TYPE = PARAM_ID_CC_VALUE + NUM_CC,
+    PARAM_ID_THRU_CHAN = PARAM_ID_THRU_TYPE + NUM_THRU_TYPES,
+    PARAM_ID_COUNT = PARAM_ID_THRU_CHAN + 16
 };
 
 static const char* CC_NAMES[] = {
@@ -174,14 +231,170 @@ static const char* CC_NAMES[] = {
     "Poly"
 };
 
+#define NUM_CC_NAMES (sizeof(CC_NAMES) / sizeof(char*))
+
+// Enumeration of CC MIDI channel, shared by all instances
+static const ParameterEnumerationValue* getChannelEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[17];
+        table() {
+            values[0].value = 0;
+            values[0].label = "Global";
+            for (int i = 1; i < 17; ++i) {
+                values[i].value = i;
+                values[i].label = String(i);
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Enumeration of thru channel map, shared by all instances
+static const ParameterEnumerationValue* getThruChannelEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[17];
+        table() {
+            values[0].value = 0;
+            values[0].label = "Block";
+            for (int i = 1; i < 17; ++i) {
+                values[i].value = i;
+                values[i].label = String(i);
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Enumeration of CC numbers with names, shared by all instances
+static const ParameterEnumerationValue* getCcEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[NUM_CC_NAMES];
+        table() {
+            for (long unsigned int i = 0; i < NUM_CC_NAMES; ++i) {
+                values[i].value = i;
+                values[i].label = String(i) + " " + CC_NAMES[i];
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Enumeration of bank select modes, shared by all instances
+static const ParameterEnumerationValue* getBankModeEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {
+        {BS_SEND_BS, "BS Only"},
+        {BS_SEND_PC, "BS+PC"},
+        {BS_SEND_LSBMSB, "LSB+MSB"},
+        {BS_SEND_ALL, "LSB+MSB+PC"}
+    };
+    return s_values;
+}
+
+// Enumeration of CC rate limit, shared by all instances
+static const ParameterEnumerationValue* getRateEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{0, "Unlimited"}};
+    return s_values;
+}
+
+// Enumeration of CC control modes, shared by all instances
+static const ParameterEnumerationValue* getCcModeEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{CC_MODE_7BIT, "7-bit CC"}, {CC_MODE_14BIT, "14-bit CC"}, {CC_MODE_NRPN, "NRPN"}, {CC_MODE_RPN, "RPN"}};
+    return s_values;
+}
+
+// Enumeration of CC feedback modes, shared by all instances
+static const ParameterEnumerationValue* getFeedbackEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{FEEDBACK_OFF, "Off"}, {FEEDBACK_THRU, "Update"}, {FEEDBACK_ABSORB, "Update & absorb"}};
+    return s_values;
+}
+
+// Enumeration of scenes, shared by all instances
+static const ParameterEnumerationValue* getSceneEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[NUM_SCENES + 1];
+        table() {
+            values[0].value = 0;
+            values[0].label = "None";
+            for (int i = 1; i <= NUM_SCENES; ++i) {
+                values[i].value = i;
+                values[i].label = String("Scene ") + String(i);
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Snapshot of the values sent by all controls
+struct scene {
+    bool stored;
+    uint8_t program;
+    uint8_t bankMsb;
+    uint8_t bankLsb;
+    uint8_t channel; // Global MIDI channel (1..16)
+    float values[NUM_CC];
+    uint8_t cc[NUM_CC];
+    uint8_t ccChan[NUM_CC];
+    uint8_t ccMode[NUM_CC];
+    uint16_t ccParam[NUM_CC];
+};
+
+struct scene_table {
+    scene scenes[NUM_SCENES];
+    uint32_t sequence; // Sequence of the state that the scenes derive from (see getState)
+};
+
+struct thru_cc_map {
+    uint8_t cc[128]; // CC number sent by MIDI thru for each CC number received or THRU_BLOCK
+};
+
+// MIDI event from a parameter change with the sample time it should be sent
+struct timed_event {
+    uint64_t time;
+    MidiEvent midi; // Event to send. For high resolution controls only the channel (status) is used
+    uint8_t control; // Index of CC control that generated event, NO_CONTROL or SCENE_RECALL
+    uint8_t mode; // CC_MODES
+    uint16_t number; // CC, NRPN or RPN number of high resolution control
+    uint16_t value; // 14-bit value of high resolution control
+};
+
+// Latest value of a CC (one per channel and CC number) or high resolution control (one per control) waiting to be sent
+struct pending_cc {
+    int16_t value   = -1; // CC value (14-bit for high resolution controls) or -1 if not pending
+    uint16_t rate   = 0;  // Maximum events per second (0 for unlimited)
+    uint64_t time   = 0;  // Sample time of latest value
+    uint16_t number = 0;  // CC, NRPN or RPN number of high resolution control
+    uint8_t channel = 0;  // MIDI channel of high resolution control (0..15)
+    uint8_t mode    = CC_MODE_7BIT; // CC_MODES of high resolution control
+};
+
+// Parameter number selected in a receiver by NRPN or RPN CCs (-1 if unknown)
+struct param_select {
+    int8_t mode = -1; // CC_MODE_NRPN or CC_MODE_RPN
+    int8_t msb  = -1;
+    int8_t lsb  = -1;
+};
+
+// True in threads that call run()
+static thread_local bool s_inRunThread = false;
+
 // Plugin that sends MIDI CC when a control is adjusted
 class CCSend : public Plugin {
   public:
     CCSend()
-        : Plugin(NUM_CC * 3 + 5, // Quantity of parameters
+        : Plugin(PARAM_ID_COUNT, // Quantity of parameters
                  0,              // Quantity of internal presets (enable DISTRHO_PLUGIN_WANT_PROGRAMS)
-                 0               // Quantity of internal states
-          ) {}
+                 2               // Quantity of internal states
+          ) {
+        resetSentState();
+        memset(m_scenes, 0, sizeof(m_scenes));
+        memset(&m_stateScenes, 0, sizeof(m_stateScenes));
+        for (uint8_t cc = 0; cc < 128; ++cc)
+            m_thruCc[cc] = m_stateThruCc.cc[cc] = cc;
+    }
 
   protected:
     // Get the plugin label. Short restricted name consisting of only _, a-z, A-Z and 0-9 characters.
@@ -237,7 +450,7 @@ class CCSend : public Plugin {
             parameter.symbol     = String("bank_lsb");
         } else if (index < PARAM_ID_GLOBAL_CHAN) {
             int idx = index - PARAM_ID_CC;
-            parameter.hints      = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.hints      = kParameterIsAutomatable; // Not integer because mode may change at runtime and fractional values give 14-bit resolution in high resolution modes
             parameter.ranges.min = 0;
             parameter.ranges.max = 127;
             parameter.ranges.def = 0;
@@ -259,16 +472,7 @@ class CCSend : public Plugin {
             parameter.ranges.min                    = 0;
             parameter.ranges.max                    = 16;
             parameter.ranges.def                    = 0;
-            parameter.enumValues.count              = 17;
-            parameter.enumValues.restrictedMode     = true;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[17];
-            values[0].value                         = 0;
-            values[0].label                         = "Global";
-            for (int i = 1; i < 17; ++i) {
-                values[i].value = i;
-                values[i].label = String(i);
-            }
-            parameter.enumValues.values      = values;
+            setSharedEnumValues(parameter, getChannelEnumValues(), 17);
             m_ccChan[idx]                    = 0;
             parameter.name                   = String(idx + 1) + " Chan";
             parameter.symbol                 = String("cc_") + String(idx + 1) + "_chan";
@@ -276,17 +480,10 @@ class CCSend : public Plugin {
         } else if (index < PARAM_ID_BS_MODE) {
             int idx                          = index - PARAM_ID_CC_NUM;
             parameter.hints                  = kParameterIsInteger;
-            parameter.enumValues.count              = sizeof(CC_NAMES) / sizeof(char*);
-            parameter.enumValues.restrictedMode     = true;
+            setSharedEnumValues(parameter, getCcEnumValues(), NUM_CC_NAMES);
             parameter.ranges.min     = 0;
-            parameter.ranges.max     = parameter.enumValues.count - 1;
+            parameter.ranges.max     = NUM_CC_NAMES - 1;
             parameter.ranges.def     = idx + 1;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[parameter.enumValues.count];
-            for (long unsigned int i = 0; i < parameter.enumValues.count; ++i) {
-                values[i].value = i;
-                values[i].label = String(i) + " " + CC_NAMES[i];
-            }
-            parameter.enumValues.values      = values;
             m_cc[idx] = parameter.ranges.def;
             parameter.name           = String(idx + 1) + " CC#";
             parameter.symbol         = String("cc_") + String(idx + 1);
@@ -296,24 +493,320 @@ class CCSend : public Plugin {
             parameter.ranges.min                    = BS_SEND_BS;
             parameter.ranges.max                    = BS_SEND_ALL;
             parameter.ranges.def                    = m_bankMode;
-            parameter.enumValues.count              = BS_SEND_ALL + 1;
-            parameter.enumValues.restrictedMode     = true;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[BS_SEND_ALL + 1];
-            values[BS_SEND_BS].value                = BS_SEND_BS;
-            values[BS_SEND_BS].label                = "BS Only";
-            values[BS_SEND_PC].value                = BS_SEND_PC;
-            values[BS_SEND_PC].label                = "BS+PC";
-            values[BS_SEND_LSBMSB].value            = BS_SEND_LSBMSB;
-            values[BS_SEND_LSBMSB].label            = "LSB+MSB";
-            values[BS_SEND_ALL].value               = BS_SEND_ALL;
-            values[BS_SEND_ALL].label               = "LSB+MSB+PC";
-            parameter.enumValues.values             = values;
+            setSharedEnumValues(parameter, getBankModeEnumValues(), BS_SEND_ALL + 1);
             parameter.name                          = "Bank Mode";
             parameter.symbol                        = "bs_mode";
             parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index < PARAM_ID_DIN_LIMIT) {
+            int idx                                 = index - PARAM_ID_CC_RATE;
+            parameter.hints                         = kParameterIsInteger | kParameterIsAutomatable;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = MAX_CC_RATE;
+            parameter.ranges.def                    = 0;
+            setSharedEnumValues(parameter, getRateEnumValues(), 1, false);
+            m_ccRate[idx]                           = 0;
+            parameter.name                          = String(idx + 1) + " Max Rate";
+            parameter.symbol                        = String("cc_") + String(idx + 1) + "_rate";
+            parameter.unit                          = "Hz";
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index == PARAM_ID_DIN_LIMIT) {
+            parameter.hints                         = kParameterIsBoolean | kParameterIsInteger | kParameterIsAutomatable;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1;
+            parameter.ranges.def                    = 0;
+            parameter.name                          = "DIN Bandwidth Limit";
+            parameter.symbol                        = "din_limit";
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index == PARAM_ID_DROPPED) {
+            parameter.name                          = "Dropped Events";
+            parameter.symbol                        = "dropped";
+            parameter.hints                         = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1000000;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index < PARAM_ID_CC_PARAM) {
+            int idx                                 = index - PARAM_ID_CC_MODE;
+            parameter.hints                         = kParameterIsInteger;
+            parameter.ranges.min                    = CC_MODE_7BIT;
+            parameter.ranges.max                    = CC_MODE_RPN;
+            parameter.ranges.def                    = CC_MODE_7BIT;
+            setSharedEnumValues(parameter, getCcModeEnumValues(), CC_MODE_RPN + 1);
+            m_ccMode[idx]                           = CC_MODE_7BIT;
+            parameter.name                          = String(idx + 1) + " Mode";
+            parameter.symbol                        = String("cc_") + String(idx + 1) + "_mode";
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index < PARAM_ID_SCENE) {
+            int idx                                 = index - PARAM_ID_CC_PARAM;
+            parameter.hints                         = kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = MAX_HIGH_RES;
+            parameter.ranges.def                    = 0;
+            m_ccParam[idx]                          = 0;
+            parameter.name                          = String(idx + 1) + " Param #";
+            parameter.symbol                        = String("cc_") + String(idx + 1) + "_param";
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index == PARAM_ID_SCENE) {
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = NUM_SCENES;
+            parameter.ranges.def                    = 0;
+            setSharedEnumValues(parameter, getSceneEnumValues(), NUM_SCENES + 1);
+            parameter.name                          = "Scene";
+            parameter.symbol                        = "scene";
+            parameter.groupId                       = GROUP_ID_PROG;
+        } else if (index == PARAM_ID_SCENE_STORE) {
+            parameter.hints                         = kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = NUM_SCENES;
+            parameter.ranges.def                    = 0;
+            setSharedEnumValues(parameter, getSceneEnumValues(), NUM_SCENES + 1);
+            parameter.name                          = "Store Scene";
+            parameter.symbol                        = "scene_store";
+            parameter.groupId                       = GROUP_ID_PROG;
+        } else if (index == PARAM_ID_SCENE_RATE) {
+            parameter.hints                         = kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = MAX_CC_RATE;
+            parameter.ranges.def                    = 0;
+            setSharedEnumValues(parameter, getRateEnumValues(), 1, false);
+            parameter.name                          = "Scene Rate";
+            parameter.symbol                        = "scene_rate";
+            parameter.unit                          = "Hz";
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index == PARAM_ID_FEEDBACK) {
+            parameter.hints                         = kParameterIsInteger;
+            parameter.ranges.min                    = FEEDBACK_OFF;
+            parameter.ranges.max                    = FEEDBACK_ABSORB;
+            parameter.ranges.def                    = FEEDBACK_OFF;
+            setSharedEnumValues(parameter, getFeedbackEnumValues(), FEEDBACK_ABSORB + 1);
+            parameter.name                          = "CC Feedback";
+            parameter.symbol                        = "feedback";
+            parameter.groupId                       = GROUP_ID_CONFIG;
+        } else if (index < PARAM_ID_THRU_TYPE) {
+            int idx                                 = index - PARAM_ID_CC_VALUE;
+            parameter.hints                         = kParameterIsOutput;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 127;
+            parameter.ranges.def                    = 0;
+            parameter.name                          = String(idx + 1) + " Value";
+            parameter.symbol                        = String("cc_") + String(idx + 1) + "_value";
+            parameter.groupId                       = GROUP_ID_CC;
+        } else if (index < PARAM_ID_THRU_CHAN) {
+            static const char* names[NUM_THRU_TYPES]   = {"Notes", "Poly Pressure", "CC", "Program Change", "Channel Pressure", "Pitch Bend", "System"};
+            static const char* symbols[NUM_THRU_TYPES] = {"note", "poly_pressure", "cc", "program", "chan_pressure", "pitch_bend", "system"};
+            int idx                                 = index - PARAM_ID_THRU_TYPE;
+            parameter.hints                         = kParameterIsBoolean | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1;
+            parameter.ranges.def                    = 1;
+            m_thruType[idx]                         = true;
+            parameter.name                          = String("Thru ") + names[idx];
+            parameter.symbol                        = String("thru_") + symbols[idx];
+            parameter.groupId                       = GROUP_ID_THRU;
+        } else if (index < PARAM_ID_COUNT) {
+            int idx                                 = index - PARAM_ID_THRU_CHAN;
+            parameter.hints                         = kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 16;
+            parameter.ranges.def                    = idx + 1;
+            setSharedEnumValues(parameter, getThruChannelEnumValues(), 17);
+            m_thruChan[idx]                         = idx + 1;
+            parameter.name                          = String("Thru Chan ") + String(idx + 1);
+            parameter.symbol                        = String("thru_chan_") + String(idx + 1);
+            parameter.groupId                       = GROUP_ID_THRU;
+        }
+    }
+
+    // Initialise state.
+    void initState(uint32_t index, State& state) override {
+        if (index == 0) {
+            state.key          = "scenes";
+            state.label        = "Scenes";
+            state.description  = "Program, bank, channel and each control's value, CC, channel, mode and parameter number of each scene";
+            state.hints        = kStateIsHostWritable;
+            state.defaultValue = "";
+        } else if (index == 1) {
+            state.key          = "thru_cc";
+            state.label        = "Thru CC Map";
+            state.description  = "Comma separated CCs changed by MIDI thru, each \"cc:new_cc\" or \"cc:-\" to block";
+            state.hints        = kStateIsHostWritable;
+            state.defaultValue = "";
+        }
+    }
+
+    // Get thru CC map as a string of "cc:new_cc" (or "cc:-" if blocked) for each CC that is changed
+    static String formatThruCcMap(const uint8_t* map) {
+        char buffer[128 * 8 + 1] = "";
+        int len = 0;
+        for (uint8_t cc = 0; cc < 128; ++cc) {
+            if (map[cc] == cc)
+                continue;
+            const char* separator = len ? "," : "";
+            if (map[cc] & THRU_BLOCK)
+                len += snprintf(buffer + len, sizeof(buffer) - len, "%s%u:-", separator, cc);
+            else
+                len += snprintf(buffer + len, sizeof(buffer) - len, "%s%u:%u", separator, cc, map[cc]);
+        }
+        return String(buffer);
+    }
+
+    // Parse thru CC map string (see formatThruCcMap). Malformed entries are ignored. CCs not listed are unchanged.
+    static void parseThruCcMap(const char* text, thru_cc_map& map) {
+        for (uint8_t cc = 0; cc < 128; ++cc)
+            map.cc[cc] = cc;
+        while (*text) {
+            char* end;
+            long cc = strtol(text, &end, 10);
+            if (end != text && *end == ':' && cc >= 0 && cc < 128) {
+                text = end + 1;
+                while (*text == ' ')
+                    ++text;
+                long newCc = strtol(text, &end, 10);
+                if (*text == '-')
+                    map.cc[cc] = THRU_BLOCK;
+                else if (end != text && newCc < 128)
+                    map.cc[cc] = newCc;
+            }
+            text = strchr(text, ',');
+            if (!text)
+                break;
+            ++text;
+        }
+    }
+
+    /*  Get scenes as a string with a group for each scene separated by ';'. Each stored scene is
+        "program,bank_msb,bank_lsb,channel" followed by ",value,cc,channel,mode,param" for each control.
+        Scenes that are not stored are empty.
+    */
+    static String formatScenes(const scene* scenes) {
+        char buffer[NUM_SCENES * (20 + NUM_CC * 32)];
+        int len = 0;
+        for (uint8_t i = 0; i < NUM_SCENES; ++i) {
+            const scene& sc = scenes[i];
+            if (i)
+                len += snprintf(buffer + len, sizeof(buffer) - len, ";");
+            if (!sc.stored)
+                continue;
+            len += snprintf(buffer + len, sizeof(buffer) - len, "%u,%u,%u,%u", sc.program, sc.bankMsb, sc.bankLsb, sc.channel);
+            for (uint8_t j = 0; j < NUM_CC; ++j)
+                len += snprintf(buffer + len, sizeof(buffer) - len, ",%g,%u,%u,%u,%u", sc.values[j], sc.cc[j], sc.ccChan[j], sc.ccMode[j], sc.ccParam[j]);
+        }
+        return String(buffer);
+    }
+
+    // Limit a parsed value to a range
+    static long clamp(double value, long min, long max) { return value < min ? min : value > max ? max : (long)value; }
+
+    // Parse scenes string (see formatScenes). Missing values are set to default.
+    static void parseScenes(const char* text, scene_table& table) {
+        memset(&table, 0, sizeof(table));
+        for (uint8_t i = 0; i < NUM_SCENES; ++i) {
+            table.scenes[i].channel = 1;
+            for (uint8_t j = 0; j < NUM_CC; ++j)
+                table.scenes[i].cc[j] = j + 1;
+        }
+        for (uint8_t i = 0; i < NUM_SCENES && *text; ++i) {
+            scene& sc = table.scenes[i];
+            for (uint32_t field = 0; *text && *text != ';'; ++field) {
+                char* end;
+                double value = strtod(text, &end);
+                if (end == text)
+                    break; // Malformed - ignore rest of scene
+                sc.stored = true;
+                text      = end;
+                if (*text == ',')
+                    ++text;
+                uint32_t control = (field - 4) / 5;
+                if (field >= 4 && control >= NUM_CC)
+                    continue;
+                switch (field < 4 ? field : 4 + (field - 4) % 5) {
+                    case 0: sc.program = clamp(value, 0, 127); break;
+                    case 1: sc.bankMsb = clamp(value, 0, 127); break;
+                    case 2: sc.bankLsb = clamp(value, 0, 127); break;
+                    case 3: sc.channel = clamp(value, 1, 16); break;
+                    case 4: sc.values[control] = value < 0 ? 0 : value > 127 ? 127 : value; break;
+                    case 5: sc.cc[control] = clamp(value, 0, 127); break;
+                    case 6: sc.ccChan[control] = clamp(value, 0, 16); break;
+                    case 7: sc.ccMode[control] = clamp(value, CC_MODE_7BIT, CC_MODE_RPN); break;
+                    case 8: sc.ccParam[control] = clamp(value, 0, MAX_HIGH_RES); break;
+                }
+            }
+            while (*text && *text != ';')
+                ++text;
+            if (*text == ';')
+                ++text;
+        }
+    }
+
+    // Set scenes or thru CC map from state. Parsed here (not audio thread) and passed to run() without blocking.
+    void setState(const char* key, const char* value) override {
+        if (strcmp(key, "scenes") == 0) {
+            scene_table& table = m_sceneState.getWriteBuffer();
+            parseScenes(value, table);
+            table.sequence = ++m_sceneSequence;
+            m_stateScenes  = table;
+            m_sceneState.publish();
+        } else if (strcmp(key, "thru_cc") == 0) {
+            thru_cc_map& map = m_thruCcState.getWriteBuffer();
+            parseThruCcMap(value, map);
+            m_stateThruCc = map;
+            m_thruCcState.publish();
         }
     }
 
+    /*  Get scenes or thru CC map, formatted from copies owned by this (non-audio) thread. Scenes are the last state set,
+        or scenes stored since, unless a newer state was set before the audio thread stored them (it will replace them).
+        Thru CC map is the last state set (only changed by setState).
+    */
+    String getState(const char* key) const override {
+        if (strcmp(key, "scenes") == 0) {
+            if (m_storedScenes.consume() && m_storedScenes.getReadBuffer().sequence == m_sceneSequence)
+                m_stateScenes = m_storedScenes.getReadBuffer();
+            return formatScenes(m_stateScenes.scenes);
+        }
+        if (strcmp(key, "thru_cc") == 0)
+            return formatThruCcMap(m_stateThruCc.cc);
+        return String();
+    }
+
+    // Store current values in a scene and pass the scenes to getState()
+    void storeScene(uint8_t index) {
+        scene& sc  = m_scenes[index];
+        sc.stored  = true;
+        sc.program = m_prog;
+        sc.bankMsb = m_bank_msb;
+        sc.bankLsb = m_bank_lsb;
+        sc.channel = m_channel;
+        memcpy(sc.values, m_val, sizeof(m_val));
+        memcpy(sc.cc, m_cc, sizeof(m_cc));
+        memcpy(sc.ccChan, m_ccChan, sizeof(m_ccChan));
+        memcpy(sc.ccMode, m_ccMode, sizeof(m_ccMode));
+        memcpy(sc.ccParam, m_ccParam, sizeof(m_ccParam));
+        scene_table& table = m_storedScenes.getWriteBuffer();
+        memcpy(table.scenes, m_scenes, sizeof(m_scenes));
+        table.sequence = m_appliedSceneSequence;
+        m_storedScenes.publish();
+    }
+
+    // Set values from a scene and queue sending the values that differ from those last sent
+    void recallScene(uint8_t index) {
+        const scene& sc = m_scenes[index];
+        if (!sc.stored)
+            return;
+        m_prog     = sc.program;
+        m_bank_msb = sc.bankMsb;
+        m_bank_lsb = sc.bankLsb;
+        m_channel  = sc.channel;
+        memcpy(m_val, sc.values, sizeof(m_val));
+        memcpy(m_cc, sc.cc, sizeof(m_cc));
+        memcpy(m_ccChan, sc.ccChan, sizeof(m_ccChan));
+        memcpy(m_ccMode, sc.ccMode, sizeof(m_ccMode));
+        memcpy(m_ccParam, sc.ccParam, sizeof(m_ccParam));
+        m_feedbackMapChanged.store(true, std::memory_order_release);
+        queueEvent(eventTime(), 0, 0, -1, SCENE_RECALL);
+    }
+
     // Initialise a port group.
     void initPortGroup(uint32_t groupId, PortGroup& portGroup) override {
         switch (groupId) {
@@ -329,6 +822,10 @@ class CCSend : public Plugin {
             portGroup.name   = String("Config");
             portGroup.symbol = String("config");
             break;
+        case GROUP_ID_THRU:
+            portGroup.name   = String("MIDI Thru");
+            portGroup.symbol = String("thru");
+            break;
         }
     }
 
@@ -345,131 +842,686 @@ class CCSend : public Plugin {
         else if (index == PARAM_ID_GLOBAL_CHAN)
             return m_channel;
         else if (index < PARAM_ID_CC_NUM)
-            return m_cc[index - PARAM_ID_CC_CHAN];
+            return m_ccChan[index - PARAM_ID_CC_CHAN];
         else if (index < PARAM_ID_BS_MODE)
-            return m_ccChan[index - PARAM_ID_CC_NUM];
+            return m_cc[index - PARAM_ID_CC_NUM];
         else if (index == PARAM_ID_BS_MODE)
             return m_bankMode;
+        else if (index < PARAM_ID_DIN_LIMIT)
+            return m_ccRate[index - PARAM_ID_CC_RATE];
+        else if (index == PARAM_ID_DIN_LIMIT)
+            return m_dinLimit;
+        else if (index == PARAM_ID_DROPPED)
+            return m_midiOut.getDropped() + m_paramEventsDropped.load(std::memory_order_relaxed);
+        else if (index < PARAM_ID_CC_PARAM)
+            return m_ccMode[index - PARAM_ID_CC_MODE];
+        else if (index < PARAM_ID_SCENE)
+            return m_ccParam[index - PARAM_ID_CC_PARAM];
+        else if (index == PARAM_ID_SCENE)
+            return m_scene;
+        else if (index == PARAM_ID_SCENE_STORE)
+            return m_sceneStore;
+        else if (index == PARAM_ID_SCENE_RATE)
+            return m_sceneRate;
+        else if (index == PARAM_ID_FEEDBACK)
+            return m_feedback;
+        else if (index < PARAM_ID_THRU_TYPE)
+            return m_val[index - PARAM_ID_CC_VALUE];
+        else if (index < PARAM_ID_THRU_CHAN)
+            return m_thruType[index - PARAM_ID_THRU_TYPE];
+        else if (index < PARAM_ID_COUNT)
+            return m_thruChan[index - PARAM_ID_THRU_CHAN];
         return 0;
     }
 
     // Set a control or parameter value
-    void setParameterValue(uint32_t index, float value) override {        
+    void setParameterValue(uint32_t index, float value) override {
         if (index == PARAM_ID_PROG) {
             // Program change
             if (value != m_prog && value >= 0 && value <= 127) {
-                MidiEvent event;
-                event.frame   = 0;
-                event.size    = 2;
-                event.data[0] = 0xc0 | (m_channel - 1);
-                event.data[1] = value;
-                writeMidiEvent(event);
+                queueEvent(eventTime(), 0xc0 | (m_channel - 1), value);
                 m_prog = value;
             }
         } else if (index == PARAM_ID_BANK_MSB) {
             // Bank MSB select
             if (value != m_bank_msb && value >= 0 && value <= 127) {
-                m_bank_msb = value;
-                MidiEvent event;
-                event.frame   = 0;
-                event.size    = 3;
-                event.data[0] = 0xb0 | (m_channel - 1);
-                event.data[1] = 0;
-                event.data[2] = m_bank_msb;
-                writeMidiEvent(event);
-                if (m_bankMode >= BS_SEND_LSBMSB) {
-                    ++event.frame;
-                    event.data[1] = 32;
-                    event.data[2] = m_bank_lsb;
-                    writeMidiEvent(event);
-                }
-                if (m_bankMode & 1) {
-                    ++event.frame;
-                    event.size    = 2;
-                    event.data[0] = 0xc0 | (m_channel - 1);
-                    event.data[1] = m_prog;
-                    writeMidiEvent(event);
-                }
+                m_bank_msb    = value;
+                uint64_t time = eventTime();
+                queueEvent(time, 0xb0 | (m_channel - 1), 0, m_bank_msb);
+                if (m_bankMode >= BS_SEND_LSBMSB)
+                    queueEvent(++time, 0xb0 | (m_channel - 1), 32, m_bank_lsb);
+                if (m_bankMode & 1)
+                    queueEvent(++time, 0xc0 | (m_channel - 1), m_prog);
             }
         } else if (index == PARAM_ID_BANK_LSB) {
             // Bank LSB select
             if (value != m_bank_lsb && value >= 0 && value <= 127) {
-                m_bank_lsb = value;
-                MidiEvent event;
-                event.frame   = 0;
-                event.size    = 3;
-                if (m_bankMode >= BS_SEND_LSBMSB) {
-                    event.data[0] = 0xb0 | (m_channel - 1);
-                    event.data[1] = 0;
-                    event.data[2] = m_bank_msb;
-                    writeMidiEvent(event);
-                    event.frame++;
-                }
-                event.data[0] = 0xb0 | (m_channel - 1);
-                event.data[1] = 32;
-                event.data[2] = m_bank_lsb;
-                writeMidiEvent(event);
-                if (m_bankMode & 1) {
-                    event.frame++;
-                    event.size    = 2;
-                    event.data[0] = 0xc0 | (m_channel - 1);
-                    event.data[1] = m_prog;
-                    writeMidiEvent(event);
-                }
+                m_bank_lsb    = value;
+                uint64_t time = eventTime();
+                if (m_bankMode >= BS_SEND_LSBMSB)
+                    queueEvent(time++, 0xb0 | (m_channel - 1), 0, m_bank_msb);
+                queueEvent(time, 0xb0 | (m_channel - 1), 32, m_bank_lsb);
+                if (m_bankMode & 1)
+                    queueEvent(++time, 0xc0 | (m_channel - 1), m_prog);
             }
         } else if (index < PARAM_ID_GLOBAL_CHAN) {
             // CC value
             int idx = index - PARAM_ID_CC;
             if (value != m_val[idx] && value >= 0 && value <= 127) {
-                MidiEvent event;
-                event.frame = 0;
-                event.size  = 3;
-                if (m_ccChan[idx] == 0)
-                    event.data[0] = 0xb0 | (m_channel - 1);
-                else
-                    event.data[0] = 0xb0 | (m_ccChan[idx] - 1);
-                event.data[1] = m_cc[idx];
-                event.data[2] = value;
-                writeMidiEvent(event);
+                uint8_t chan = (m_ccChan[idx] ? m_ccChan[idx] : m_channel) - 1;
+                if (m_ccMode[idx] == CC_MODE_7BIT || (m_ccMode[idx] == CC_MODE_14BIT && m_cc[idx] > 31)) {
+                    value = uint8_t(value + 0.5f); // 7-bit controls hold whole values
+                    if (uint8_t(value) != uint8_t(m_val[idx] + 0.5f))
+                        queueEvent(eventTime(), 0xb0 | chan, m_cc[idx], uint8_t(value), idx);
+                } else {
+                    uint16_t value14 = value * MAX_HIGH_RES / 127 + 0.5f;
+                    if (value14 != uint16_t(m_val[idx] * MAX_HIGH_RES / 127 + 0.5f))
+                        queueHighResEvent(eventTime(), chan, idx, value14);
+                }
                 m_val[idx] = value;
             }
         } else if (index == PARAM_ID_GLOBAL_CHAN) {
             // Global MIDI channel
             if (value != m_channel && value >= 1 && value <= 16) {
                 m_channel = value;
+                m_feedbackMapChanged.store(true, std::memory_order_release);
             }
         } else if (index < PARAM_ID_CC_NUM) {
             // CC MIDI channel
             int idx = index - PARAM_ID_CC_CHAN;
-            if (value != m_ccChan[idx] && value >= 0 && value <= 16)
+            if (value != m_ccChan[idx] && value >= 0 && value <= 16) {
                 m_ccChan[idx] = value;
+                m_feedbackMapChanged.store(true, std::memory_order_release);
+            }
         } else if (index < PARAM_ID_BS_MODE) {
             // CC number
             int idx = index - PARAM_ID_CC_NUM;
             if (value != m_cc[idx] && value >= 0 && value <= 127) {
                 m_cc[idx] = value;
+                m_feedbackMapChanged.store(true, std::memory_order_release);
             }
         } else if (index == PARAM_ID_BS_MODE && value >= BS_SEND_BS && value <= BS_SEND_ALL) {
             m_bankMode = value;
+        } else if (index < PARAM_ID_DIN_LIMIT) {
+            // CC rate limit
+            if (value >= 0 && value <= MAX_CC_RATE)
+                m_ccRate[index - PARAM_ID_CC_RATE] = value;
+        } else if (index == PARAM_ID_DIN_LIMIT) {
+            m_dinLimit = value >= 0.5f;
+        } else if (index < PARAM_ID_CC_PARAM) {
+            if (value >= CC_MODE_7BIT && value <= CC_MODE_RPN) {
+                m_ccMode[index - PARAM_ID_CC_MODE] = value;
+                m_feedbackMapChanged.store(true, std::memory_order_release);
+            }
+        } else if (index < PARAM_ID_SCENE) {
+            if (value >= 0 && value <= MAX_HIGH_RES)
+                m_ccParam[index - PARAM_ID_CC_PARAM] = value;
+        } else if (index == PARAM_ID_SCENE) {
+            if (value >= 0 && value <= NUM_SCENES) {
+                m_scene = value;
+                if (m_scene)
+                    recallScene(m_scene - 1); // Recalled on every write so that a scene may be recalled again
+            }
+        } else if (index == PARAM_ID_SCENE_STORE) {
+            if (value != m_sceneStore && value >= 0 && value <= NUM_SCENES) {
+                m_sceneStore = value;
+                if (m_sceneStore)
+                    storeScene(m_sceneStore - 1);
+            }
+        } else if (index == PARAM_ID_SCENE_RATE) {
+            if (value >= 0 && value <= MAX_CC_RATE)
+                m_sceneRate = value;
+        } else if (index == PARAM_ID_FEEDBACK) {
+            if (value >= FEEDBACK_OFF && value <= FEEDBACK_ABSORB)
+                m_feedback = value;
+        } else if (index >= PARAM_ID_THRU_TYPE && index < PARAM_ID_THRU_CHAN) {
+            bool allow = value >= 0.5f;
+            if (allow != m_thruType[index - PARAM_ID_THRU_TYPE]) {
+                m_thruType[index - PARAM_ID_THRU_TYPE] = allow;
+                m_thruStatusChanged.store(true, std::memory_order_release);
+            }
+        } else if (index >= PARAM_ID_THRU_CHAN && index < PARAM_ID_COUNT) {
+            if (value != m_thruChan[index - PARAM_ID_THRU_CHAN] && value >= 0 && value <= 16) {
+                m_thruChan[index - PARAM_ID_THRU_CHAN] = value;
+                m_thruStatusChanged.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    // Get the sample time at which an event generated now should be sent.
+    // Changes made by the audio thread between cycles (e.g. LV2 control ports) are sent at the start of the next cycle.
+    // Changes made by other threads are placed at their position within the cycle they occurred, delayed by one cycle.
+    uint64_t eventTime() {
+        uint64_t blockStart = m_blockStart.load(std::memory_order_acquire);
+        uint32_t frames     = m_blockFrames.load(std::memory_order_relaxed);
+        if (s_inRunThread)
+            return blockStart + frames;
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() -
+                          m_blockStartNs.load(std::memory_order_relaxed);
+        uint64_t offset = elapsed > 0 ? elapsed * getSampleRate() / 1000000000 : 0;
+        if (offset > frames)
+            offset = frames;
+        return blockStart + frames + offset;
+    }
+
+    // Add a MIDI message to the queue of events to be sent by run()
+    void queueEvent(uint64_t time, uint8_t status, uint8_t data1, int data2 = -1, uint8_t control = NO_CONTROL) {
+        timed_event event;
+        event.time         = time;
+        event.control      = control;
+        event.mode         = CC_MODE_7BIT;
+        event.number       = 0;
+        event.value        = 0;
+        event.midi.frame   = 0;
+        event.midi.size    = data2 < 0 ? 2 : 3;
+        event.midi.data[0] = status;
+        event.midi.data[1] = data1;
+        event.midi.data[2] = data2 < 0 ? 0 : data2;
+        event.midi.data[3] = 0;
+        event.midi.dataExt = nullptr;
+        if (!m_paramEvents.push(event))
+            m_paramEventsDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Add a value of a high resolution (14-bit CC, NRPN or RPN) control to the queue of events to be sent by run()
+    void queueHighResEvent(uint64_t time, uint8_t channel, uint8_t control, uint16_t value) {
+        timed_event event;
+        memset(&event, 0, sizeof(event));
+        event.time         = time;
+        event.control      = control;
+        event.mode         = m_ccMode[control];
+        event.number       = event.mode == CC_MODE_14BIT ? m_cc[control] : m_ccParam[control];
+        event.value        = value;
+        event.midi.data[0] = 0xb0 | channel;
+        if (!m_paramEvents.push(event))
+            m_paramEventsDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Forget the controller state of the receiver so that high resolution controls and scene recall next send all bytes
+    void resetSentState() {
+        memset(m_sentCc, 0xff, sizeof(m_sentCc));
+        memset(m_sentProgram, 0xff, sizeof(m_sentProgram));
+        for (param_select& select : m_paramSelect)
+            select = param_select();
+    }
+
+    // Track the controller state of the receiver from each CC and program change sent (including MIDI thru)
+    void trackSentState(const MidiEvent& event) {
+        if (event.size == 2 && (event.data[0] & 0xf0) == 0xc0)
+            m_sentProgram[event.data[0] & 0x0f] = event.data[1] & 0x7f;
+        if (event.size != 3 || (event.data[0] & 0xf0) != 0xb0)
+            return;
+        uint8_t chan  = event.data[0] & 0x0f;
+        uint8_t cc    = event.data[1] & 0x7f;
+        int8_t value  = event.data[2] & 0x7f;
+        m_sentCc[chan][cc] = value;
+        if (cc < 32) {
+            m_sentCc[chan][cc + 32] = -1; // Receivers may reset LSB when MSB changes
+        } else if (cc >= 96 && cc <= 101) {
+            if (cc >= 98) {
+                // NRPN (99/98) or RPN (101/100) parameter number MSB (odd) or LSB (even)
+                param_select& select = m_paramSelect[chan];
+                int8_t mode          = cc >= 100 ? CC_MODE_RPN : CC_MODE_NRPN;
+                if (select.mode != mode) {
+                    select.mode = mode;
+                    select.msb  = -1;
+                    select.lsb  = -1;
+                }
+                (cc & 1 ? select.msb : select.lsb) = value;
+            }
+            // Data entry value of selected parameter is unknown after selection or increment / decrement
+            m_sentCc[chan][6]  = -1;
+            m_sentCc[chan][38] = -1;
+        } else if (cc == 121) {
+            // Reset all controllers
+            memset(m_sentCc[chan], 0xff, sizeof(m_sentCc[chan]));
+            m_paramSelect[chan] = param_select();
+        }
+    }
+
+    // Set a MIDI event to a CC (or program change if data2 < 0)
+    static void setEvent(MidiEvent& event, uint8_t status, uint8_t data1, int data2 = -1) {
+        event.frame   = 0;
+        event.size    = data2 < 0 ? 2 : 3;
+        event.data[0] = status;
+        event.data[1] = data1;
+        event.data[2] = data2 < 0 ? 0 : data2;
+        event.data[3] = 0;
+        event.dataExt = nullptr;
+    }
+
+    /*  Get the events (up to 4) that set a high resolution value, omitting parameter selection and MSB already held by
+        the receiver (like running status). Selecting a parameter or sending MSB makes the following LSB unknown so
+        it is always sent. Returns quantity of events.
+    */
+    uint8_t getHighResEvents(uint8_t mode, uint8_t chan, uint16_t number, uint16_t value, MidiEvent* events) const {
+        uint8_t count      = 0;
+        uint8_t controller = number; // MSB controller (LSB is controller + 32)
+        bool selected      = false; // True if parameter selection is sent
+        if (mode != CC_MODE_14BIT) {
+            const param_select& select = m_paramSelect[chan];
+            uint8_t selectCc           = mode == CC_MODE_RPN ? 100 : 98; // Parameter number LSB (MSB is selectCc + 1)
+            if (select.mode != mode || select.msb != number >> 7) {
+                setEvent(events[count++], 0xb0 | chan, selectCc + 1, number >> 7);
+                selected = true;
+            }
+            if (select.mode != mode || select.lsb != (number & 0x7f)) {
+                setEvent(events[count++], 0xb0 | chan, selectCc, number & 0x7f);
+                selected = true;
+            }
+            controller = 6; // Data entry
+        }
+        if (selected || m_sentCc[chan][controller] != value >> 7) {
+            setEvent(events[count++], 0xb0 | chan, controller, value >> 7);
+            setEvent(events[count++], 0xb0 | chan, controller + 32, value & 0x7f);
+        } else if (m_sentCc[chan][controller + 32] != (value & 0x7f)) {
+            setEvent(events[count++], 0xb0 | chan, controller + 32, value & 0x7f);
+        }
+        return count;
+    }
+
+    // Send a CC to the host at a frame within the cycle
+    void sendCc(uint8_t channel, uint8_t cc, uint8_t value, uint64_t blockStart, uint32_t frame) {
+        MidiEvent event;
+        setEvent(event, 0xb0 | channel, cc, value);
+        event.frame = frame;
+        sendEvent(event, blockStart + frame);
+    }
+
+    // Send a high resolution value with only the bytes that change at the receiver
+    void sendHighRes(const pending_cc& cc, uint64_t blockStart, uint32_t frame) {
+        MidiEvent events[4];
+        uint8_t count = getHighResEvents(cc.mode, cc.channel, cc.number, cc.value, events);
+        for (uint8_t i = 0; i < count; ++i) {
+            events[i].frame = frame;
+            sendEvent(events[i], blockStart + frame);
         }
     }
 
+    // Send an event to the host, accounting for the time it occupies a serial MIDI port
+    void sendEvent(const MidiEvent& event, uint64_t time) {
+        uint32_t dropped = m_midiOut.getDropped();
+        m_midiOut.write(this, event);
+        if (m_midiOut.getDropped() != dropped)
+            resetSentState(); // Receiver did not get event so its state is unknown
+        else
+            trackSentState(event);
+        if (m_dinLimit) {
+            if (m_dinFree < time)
+                m_dinFree = time;
+            m_dinFree += event.size * getSampleRate() / DIN_BYTES_PER_SECOND;
+        }
+    }
+
+    // Map the channel and CC number of each control to the control for O(1) lookup of incoming CCs.
+    // Lower controls take precedence if more than one control sends the same CC. NRPN and RPN controls are not mapped.
+    void updateFeedbackMap() {
+        memset(m_feedbackMap, NO_CONTROL, sizeof(m_feedbackMap));
+        for (int idx = NUM_CC - 1; idx >= 0; --idx) {
+            uint8_t chan = (m_ccChan[idx] ? m_ccChan[idx] : m_channel) - 1;
+            if (m_ccMode[idx] == CC_MODE_7BIT || (m_ccMode[idx] == CC_MODE_14BIT && m_cc[idx] > 31)) {
+                m_feedbackMap[chan][m_cc[idx]] = idx;
+            } else if (m_ccMode[idx] == CC_MODE_14BIT) {
+                m_feedbackMap[chan][m_cc[idx]]      = idx;
+                m_feedbackMap[chan][m_cc[idx] + 32] = idx | FEEDBACK_LSB;
+            }
+        }
+    }
+
+    // Update the control that sends an incoming CC. Returns true if the CC matched a control.
+    bool receiveCc(const MidiEvent& event) {
+        uint8_t control = m_feedbackMap[event.data[0] & 0x0f][event.data[1] & 0x7f];
+        if (control == NO_CONTROL)
+            return false;
+        uint8_t value = event.data[2] & 0x7f;
+        uint8_t idx   = control & ~FEEDBACK_LSB;
+        if (m_ccMode[idx] == CC_MODE_7BIT || m_cc[idx] > 31)
+            m_val[idx] = value;
+        else if (control & FEEDBACK_LSB)
+            m_val[idx] = ((uint16_t(m_val[idx] * MAX_HIGH_RES / 127 + 0.5f) & 0x3f80) | value) * 127.0f / MAX_HIGH_RES;
+        else
+            m_val[idx] = (value << 7) * 127.0f / MAX_HIGH_RES; // LSB is reset by MSB
+        return true;
+    }
+
+    /*  Build the thru status table that gives the status byte sent by MIDI thru for each status byte received (0 to
+        block), combining the message type filter and channel map so that routing an event needs no checks of
+        configuration. Data bytes (0..0x7f) are blocked.
+    */
+    void updateThruStatus() {
+        static const uint8_t CHANNEL_TYPES[8] = {THRU_NOTE, THRU_NOTE, THRU_POLY_PRESSURE, THRU_CC, THRU_PROGRAM, THRU_CHAN_PRESSURE, THRU_PITCH_BEND, THRU_SYSTEM};
+        memset(m_thruStatus, 0, 0x80);
+        for (uint16_t status = 0x80; status < 0xf0; ++status) {
+            uint8_t chan         = m_thruChan[status & 0x0f];
+            m_thruStatus[status] = m_thruType[CHANNEL_TYPES[(status >> 4) & 0x07]] && chan ? (status & 0xf0) | (chan - 1) : 0;
+        }
+        for (uint16_t status = 0xf0; status < 0x100; ++status)
+            m_thruStatus[status] = m_thruType[THRU_SYSTEM] ? status : 0;
+    }
+
+    // Apply thru routing to an event received. Returns false if event is blocked.
+    bool routeThru(const MidiEvent& in, MidiEvent& out) const {
+        out = in;
+        if (in.size > MidiEvent::kDataSize)
+            return m_thruStatus[in.dataExt[0]] != 0; // Long system exclusive is passed unchanged
+        out.data[0] = m_thruStatus[in.data[0]];
+        if ((out.data[0] & 0xf0) != 0xb0)
+            return out.data[0] != 0;
+        out.data[1] = m_thruCc[in.data[1] & 0x7f];
+        return !(out.data[1] & THRU_BLOCK);
+    }
+
+    // Add an event to be sent this cycle, sorted by time (equal times keep order added). Returns false if full.
+    bool addBlockEvent(const timed_event& event) {
+        if (m_blockEventCount >= PARAM_EVENT_QUEUE_SIZE)
+            return false;
+        uint32_t i = m_blockEventCount++;
+        for (; i > m_blockEventIndex && m_blockEvents[i - 1].time > event.time; --i)
+            m_blockEvents[i] = m_blockEvents[i - 1];
+        m_blockEvents[i] = event;
+        return true;
+    }
+
+    // Move parameter events due within this cycle from the queue. CC control values are coalesced, latest value wins.
+    // Other events are kept sorted by time, so events queued out of order (e.g. by different threads) are still sent in order.
+    // Events delayed beyond the previous cycle by serial MIDI bandwidth are kept ahead of new events.
+    void fetchParamEvents(uint64_t blockEnd) {
+        const timed_event* event;
+        m_blockEventCount -= m_blockEventIndex;
+        memmove(m_blockEvents, m_blockEvents + m_blockEventIndex, m_blockEventCount * sizeof(timed_event));
+        m_blockEventIndex = 0;
+        while ((event = m_paramEvents.peek()) && event->time < blockEnd) {
+            if (event->control == NO_CONTROL || event->control == SCENE_RECALL) {
+                if (!addBlockEvent(*event))
+                    break; // Full of delayed events - leave in queue until next cycle
+                if (event->control == SCENE_RECALL)
+                    clearPendingCc(); // Superseded by scene
+            } else if (event->mode != CC_MODE_7BIT) {
+                uint16_t key = HIGH_RES_KEY + event->control;
+                pending_cc& cc = m_pendingCc[key];
+                if (cc.value < 0)
+                    m_pendingKeys[m_pendingCount++] = key;
+                cc.value   = event->value;
+                cc.rate    = m_ccRate[event->control];
+                cc.time    = event->time;
+                cc.number  = event->number;
+                cc.channel = event->midi.data[0] & 0x0f;
+                cc.mode    = event->mode;
+            } else {
+                uint16_t key = ((event->midi.data[0] & 0x0f) << 7) | event->midi.data[1];
+                pending_cc& cc = m_pendingCc[key];
+                if (cc.value < 0)
+                    m_pendingKeys[m_pendingCount++] = key;
+                cc.value = event->midi.data[2];
+                cc.rate  = m_ccRate[event->control];
+                cc.time  = event->time;
+            }
+            m_paramEvents.pop();
+        }
+    }
+
+    // Discard values of CCs waiting to be sent
+    void clearPendingCc() {
+        for (uint32_t i = 0; i < m_pendingCount; ++i)
+            m_pendingCc[m_pendingKeys[i]].value = -1;
+        m_pendingCount = 0;
+    }
+
+    // Get the events (up to 4) that set part of the current scene that differs from the receiver's state
+    // Part 0 is bank and program, then one part for each control. Returns quantity of events.
+    uint8_t getSceneEvents(uint8_t part, MidiEvent* events) const {
+        uint8_t count = 0;
+        if (part == 0) {
+            // Bank select is sent as by the bank parameters, following bank select mode
+            uint8_t chan    = m_channel - 1;
+            bool msbChanged = m_sentCc[chan][0] != m_bank_msb;
+            bool lsbChanged = m_sentCc[chan][32] != m_bank_lsb;
+            bool both       = m_bankMode >= BS_SEND_LSBMSB && (msbChanged || lsbChanged);
+            if (msbChanged || both)
+                setEvent(events[count++], 0xb0 | chan, 0, m_bank_msb);
+            if (lsbChanged || both)
+                setEvent(events[count++], 0xb0 | chan, 32, m_bank_lsb);
+            if (((m_bankMode & 1) && (msbChanged || lsbChanged)) || m_sentProgram[chan] != m_prog)
+                setEvent(events[count++], 0xc0 | chan, m_prog);
+            return count;
+        }
+        uint8_t idx  = part - 1;
+        uint8_t chan = (m_ccChan[idx] ? m_ccChan[idx] : m_channel) - 1;
+        if (m_ccMode[idx] == CC_MODE_7BIT || (m_ccMode[idx] == CC_MODE_14BIT && m_cc[idx] > 31)) {
+            uint8_t value = m_val[idx] + 0.5f;
+            if (m_sentCc[chan][m_cc[idx]] != value)
+                setEvent(events[count++], 0xb0 | chan, m_cc[idx], value);
+            return count;
+        }
+        uint16_t number = m_ccMode[idx] == CC_MODE_14BIT ? m_cc[idx] : m_ccParam[idx];
+        return getHighResEvents(m_ccMode[idx], chan, number, m_val[idx] * MAX_HIGH_RES / 127 + 0.5f, events);
+    }
+
+    // Start sending the current scene from a sample time
+    void startRecall(uint64_t time) {
+        m_recallActive = true;
+        m_recallPart   = 0;
+        m_recallCount  = 0;
+        m_recallIndex  = 0;
+        m_recallNext   = time;
+    }
+
+    // Get the next event of scene recall or null when recall is complete. Each part of the scene is compared
+    // with the receiver's state when it becomes due, so that only values that differ are sent.
+    const MidiEvent* peekRecall() {
+        while (m_recallIndex >= m_recallCount) {
+            if (m_recallPart > NUM_CC) {
+                m_recallActive = false;
+                return nullptr;
+            }
+            m_recallCount = getSceneEvents(m_recallPart++, m_recallEvents);
+            m_recallIndex = 0;
+        }
+        return &m_recallEvents[m_recallIndex];
+    }
+
+    // True if there are parameter events, CCs or scene recall waiting to be sent
+    bool hasParamEvents() const { return m_blockEventIndex < m_blockEventCount || m_pendingCount || m_recallActive; }
+
+    // Get the earliest sample time that a pending CC may be sent within its rate limit
+    uint64_t getCcDue(uint16_t key) const {
+        uint64_t time = m_pendingCc[key].time;
+        return time > m_ccNext[key] ? time : m_ccNext[key];
+    }
+
+    // Send the pending value of a CC or high resolution control
+    void sendPendingCc(uint16_t key, uint64_t blockStart, uint32_t frame) {
+        pending_cc& cc = m_pendingCc[key];
+        if (key < HIGH_RES_KEY)
+            sendCc(key >> 7, key & 0x7f, cc.value, blockStart, frame);
+        else
+            sendHighRes(cc, blockStart, frame);
+        m_ccNext[key] = blockStart + frame + (cc.rate ? uint64_t(getSampleRate() / cc.rate) : 0);
+        cc.value      = -1;
+    }
+
+    /*  Send parameter events and pending CCs due before the given frame. Both are sorted by time and merged
+        so that output frames never decrease (lastFrame is the frame of the last event sent in this cycle).
+        Pending CCs are delayed by their rate limit and, if enabled, serial MIDI bandwidth.
+    */
+    void sendParamEvents(uint64_t blockStart, uint32_t frame, uint32_t& lastFrame) {
+        uint64_t end = blockStart + frame;
+        // Move pending CCs that are due into m_dueKeys, sorted by time (equal times keep order of change)
+        uint32_t remaining = 0;
+        uint32_t dueCount  = 0;
+        for (uint32_t i = 0; i < m_pendingCount; ++i) {
+            uint16_t key = m_pendingKeys[i];
+            uint64_t due = getCcDue(key);
+            if (due >= end) {
+                m_pendingKeys[remaining++] = key; // Not yet due - retain order
+                continue;
+            }
+            uint32_t j = dueCount++;
+            for (; j > 0 && getCcDue(m_dueKeys[j - 1]) > due; --j)
+                m_dueKeys[j] = m_dueKeys[j - 1];
+            m_dueKeys[j] = key;
+        }
+        m_pendingCount = remaining;
+
+        uint32_t dueIndex = 0;
+        while (true) {
+            uint64_t eventTime = UINT64_MAX;
+            if (m_blockEventIndex < m_blockEventCount) {
+                eventTime = m_blockEvents[m_blockEventIndex].time;
+                if (m_dinLimit && eventTime < m_dinFree)
+                    eventTime = m_dinFree + 0.5;
+            }
+            uint64_t ccTime    = UINT64_MAX;
+            if (dueIndex < dueCount) {
+                ccTime = getCcDue(m_dueKeys[dueIndex]);
+                if (m_dinLimit && ccTime < m_dinFree)
+                    ccTime = m_dinFree + 0.5;
+            }
+            uint64_t recallTime = UINT64_MAX;
+            if (m_recallActive && peekRecall()) {
+                recallTime = m_recallNext + 0.5;
+                if (m_dinLimit && recallTime < m_dinFree)
+                    recallTime = m_dinFree + 0.5;
+            }
+            uint64_t time = eventTime;
+            if (recallTime < time)
+                time = recallTime;
+            if (ccTime < time)
+                time = ccTime;
+            if (time >= end)
+                break;
+            uint32_t eventFrame = time > blockStart ? time - blockStart : 0;
+            if (eventFrame < lastFrame)
+                eventFrame = lastFrame; // Keep output in time order, e.g. bank select bursts from consecutive changes
+            lastFrame = eventFrame;
+            if (eventTime == time) {
+                timed_event& event = m_blockEvents[m_blockEventIndex++];
+                if (event.control == SCENE_RECALL) {
+                    startRecall(time);
+                    continue;
+                }
+                event.midi.frame = eventFrame;
+                sendEvent(event.midi, blockStart + eventFrame);
+            } else if (recallTime == time) {
+                // Scene events are spread at scene rate (consecutive frames if unlimited)
+                MidiEvent event = m_recallEvents[m_recallIndex++];
+                event.frame     = eventFrame;
+                sendEvent(event, blockStart + eventFrame);
+                m_recallNext = blockStart + eventFrame + (m_sceneRate ? getSampleRate() / m_sceneRate : 1.0);
+            } else {
+                sendPendingCc(m_dueKeys[dueIndex++], blockStart, eventFrame);
+            }
+        }
+        // Events and CCs delayed beyond this frame by serial MIDI bandwidth remain pending
+        for (; dueIndex < dueCount; ++dueIndex)
+            m_pendingKeys[m_pendingCount++] = m_dueKeys[dueIndex];
+    }
+
     // Process audio and MIDI input.
-    void run(const float**, float**, uint32_t, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
-        // Pass all MIDI thru
-        for (uint32_t j = 0; j < midiEventCount; ++j)
-            writeMidiEvent(midiEvents[j]);
+    void run(const float**, float**, uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
+        s_inRunThread       = true;
+        uint64_t blockStart = m_blockStart.load(std::memory_order_relaxed) + m_blockFrames.load(std::memory_order_relaxed);
+        m_blockStartNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(),
+                             std::memory_order_relaxed);
+        m_blockFrames.store(frames, std::memory_order_relaxed);
+        m_blockStart.store(blockStart, std::memory_order_release);
+
+        m_midiOut.flush(this); // Send events that did not fit in previous cycle
+        if (m_feedbackMapChanged.exchange(false, std::memory_order_acquire))
+            updateFeedbackMap();
+        if (m_thruStatusChanged.exchange(false, std::memory_order_acquire))
+            updateThruStatus();
+        if (m_thruCcState.consume())
+            memcpy(m_thruCc, m_thruCcState.getReadBuffer().cc, sizeof(m_thruCc));
+        if (m_sceneState.consume()) {
+            memcpy(m_scenes, m_sceneState.getReadBuffer().scenes, sizeof(m_scenes));
+            m_appliedSceneSequence = m_sceneState.getReadBuffer().sequence;
+        }
+        fetchParamEvents(blockStart + frames);
+        // Pass all MIDI thru, merged in time order with events from parameter changes. Output frames never decrease.
+        uint32_t lastFrame = 0;
+        for (uint32_t j = 0; j < midiEventCount; ++j) {
+            if (hasParamEvents())
+                sendParamEvents(blockStart, midiEvents[j].frame + 1, lastFrame);
+            if (m_feedback && midiEvents[j].size == 3 && (midiEvents[j].data[0] & 0xf0) == 0xb0 && receiveCc(midiEvents[j]) &&
+                m_feedback == FEEDBACK_ABSORB)
+                continue; // Absorbed CC only updates the control. Nothing is sent so sent state is unchanged.
+            timed_event thru;
+            MidiEvent& event = thru.midi;
+            if (!routeThru(midiEvents[j], event))
+                continue;
+            if (m_dinLimit && event.size <= MidiEvent::kDataSize) {
+                // Held with parameter events until serial MIDI port is free. Long sysex references host memory so is sent now.
+                thru.time    = blockStart + event.frame;
+                thru.control = NO_CONTROL;
+                if (addBlockEvent(thru))
+                    continue;
+            }
+            if (event.frame < lastFrame)
+                event.frame = lastFrame; // Host input out of order
+            lastFrame = event.frame;
+            sendEvent(event, blockStart + lastFrame);
+        }
+        if (hasParamEvents())
+            sendParamEvents(blockStart, frames, lastFrame);
     }
 
   private:
-    uint8_t m_val[NUM_CC];
+    float m_val[NUM_CC]; // Value of each CC control (0..127, fractional for high resolution modes)
     uint8_t m_cc[NUM_CC];
     uint8_t m_ccChan[NUM_CC];
+    uint8_t m_ccMode[NUM_CC]; // CC_MODES of each CC control
+    uint16_t m_ccParam[NUM_CC]; // NRPN or RPN number of each CC control
     uint8_t m_prog     = 0;
     uint8_t m_bank_lsb = 0;
     uint8_t m_bank_msb = 0;
     uint8_t m_channel  = 1; // Global MIDI channel (1..16)
     uint8_t m_bankMode = BS_SEND_BS; // True to send program change after bank select
+    MidiOutQueue m_midiOut; // Events waiting for space in host output buffer
+    SpscQueue<timed_event, PARAM_EVENT_QUEUE_SIZE> m_paramEvents; // Events from parameter changes waiting to be sent by run()
+    std::atomic<uint32_t> m_paramEventsDropped{0}; // Quantity of parameter events dropped because queue was full
+    std::atomic<uint64_t> m_blockStart{0}; // Sample time of start of current (or last) cycle
+    std::atomic<uint32_t> m_blockFrames{0}; // Quantity of frames in current (or last) cycle
+    std::atomic<int64_t> m_blockStartNs{0}; // Monotonic clock (ns) at start of current (or last) cycle
+    timed_event m_blockEvents[PARAM_EVENT_QUEUE_SIZE]; // Parameter events (other than CC controls) due in this cycle and MIDI thru waiting for serial MIDI bandwidth
+    uint32_t m_blockEventCount = 0; // Quantity of events in m_blockEvents
+    uint32_t m_blockEventIndex = 0; // Index of next event in m_blockEvents to send
+    uint16_t m_ccRate[NUM_CC]; // Maximum rate of each CC control (events per second, 0 for unlimited)
+    pending_cc m_pendingCc[NUM_PENDING]; // Latest unsent value of each CC, indexed by (channel << 7 | CC number), then of each high resolution control
+    uint16_t m_pendingKeys[NUM_PENDING]; // Index of each pending CC in order of first change
+    uint16_t m_dueKeys[NUM_PENDING]; // Index of each pending CC due within the current part of the cycle, sorted by time
+    uint32_t m_pendingCount = 0; // Quantity of pending CCs
+    uint64_t m_ccNext[NUM_PENDING] = {}; // Earliest sample time that each CC may next be sent due to rate limit
+    int8_t m_sentCc[16][128]; // Last value sent to each CC of each channel, -1 if unknown
+    int8_t m_sentProgram[16]; // Last program sent on each channel, -1 if unknown
+    param_select m_paramSelect[16]; // NRPN or RPN selected on each channel
+    scene m_scenes[NUM_SCENES]; // Scene snapshots
+    TripleBuffer<scene_table> m_sceneState; // Scenes from setState() waiting for run()
+    mutable TripleBuffer<scene_table> m_storedScenes; // Scenes changed by storeScene() waiting for getState()
+    mutable scene_table m_stateScenes; // Scenes reported by getState(). Only accessed by non-audio thread
+    uint32_t m_sceneSequence        = 0; // Quantity of scene states set (non-audio thread)
+    uint32_t m_appliedSceneSequence = 0; // Sequence of last scene state applied by audio thread
+    uint8_t m_scene      = 0; // Index of last recalled scene + 1, 0 for none
+    uint8_t m_sceneStore = 0; // Index of last stored scene + 1, 0 for none
+    uint16_t m_sceneRate = 0; // Maximum events per second sent by scene recall (0 for one per frame)
+    bool m_recallActive  = false; // True whilst sending a recalled scene
+    uint8_t m_recallPart = 0; // Index of next part of scene to send (0 for bank and program, then each control)
+    MidiEvent m_recallEvents[4]; // Events of current part of scene
+    uint8_t m_recallCount = 0; // Quantity of events in m_recallEvents
+    uint8_t m_recallIndex = 0; // Index of next event in m_recallEvents to send
+    double m_recallNext   = 0; // Sample time that next scene event may be sent
+    uint8_t m_feedback    = FEEDBACK_OFF; // FEEDBACK_MODES
+    uint8_t m_feedbackMap[16][128]; // Index of control (with FEEDBACK_LSB flag) that sends each CC, indexed by channel and CC number
+    std::atomic<bool> m_feedbackMapChanged{true}; // True if channel, CC number or mode of a control changed since map was updated
+    bool m_thruType[NUM_THRU_TYPES]; // True to pass each THRU_TYPES
+    uint8_t m_thruChan[16]; // Channel (1..16) sent by MIDI thru for each channel received, 0 to block
+    uint8_t m_thruStatus[256]; // Status sent by MIDI thru for each status received, 0 to block
+    uint8_t m_thruCc[128]; // CC number sent by MIDI thru for each CC number received or THRU_BLOCK
+    std::atomic<bool> m_thruStatusChanged{true}; // True if thru type filter or channel map changed since status table was updated
+    TripleBuffer<thru_cc_map> m_thruCcState; // Thru CC map from setState() waiting for run()
+    thru_cc_map m_stateThruCc; // Thru CC map reported by getState(). Only accessed by non-audio thread
+    bool m_dinLimit = false; // True to limit output to serial MIDI bandwidth
+    double m_dinFree = 0; // Sample time when serial MIDI port will have sent all output
 
     // Set our plugin class as non-copyable and add a leak detector just in case.
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CCSend)
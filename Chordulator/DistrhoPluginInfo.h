@@ -28,5 +28,6 @@
 #define DISTRHO_PLUGIN_WANT_MIDI_INPUT  1
 #define DISTRHO_PLUGIN_WANT_MIDI_OUTPUT 1
 #define DISTRHO_PLUGIN_WANT_PROGRAMS    0
+#define DISTRHO_PLUGIN_WANT_TIMEPOS     1
  
 #endif // DISTRHO_PLUGIN_INFO_H_INCLUDED
@@ -14,10 +14,49 @@
  */
 
 #include "DistrhoPlugin.hpp"
+#include "EnumTables.hpp"
+#include "MidiOutQueue.hpp"
+#include "VoiceLimiter.hpp"
+
+#include <cmath>
 
 START_NAMESPACE_DISTRHO
 
 #define MAX_CHORD_NOTES 8
+#define MAX_ARP_OCTAVES 4
+
+enum TRANSITION_MODES {
+    TRANSITION_RETRIGGER = 0, // Release whole chord then play new chord
+    TRANSITION_COMMON    = 1  // Hold notes common to both chords, only release removed and play added notes
+};
+
+enum CHANNEL_MODES {
+    CHANNEL_MODE_OMNI        = 0, // All MIDI channels share one modifier and set of held notes
+    CHANNEL_MODE_INDEPENDENT = 1  // Each MIDI channel has its own modifier and held notes
+};
+
+enum ARP_PATTERNS {
+    ARP_UP      = 0, // Play chord notes from lowest to highest
+    ARP_DOWN    = 1, // Play chord notes from highest to lowest
+    ARP_UP_DOWN = 2, // Play chord notes up then down without repeating the top and bottom notes
+    ARP_RANDOM  = 3  // Play chord notes in random order
+};
+
+// Length of arpeggiator step in quarter notes, indexed by rate parameter value
+static const double ARP_RATE_QUARTERS[] = {4.0, 2.0, 1.0, 0.5, 1.0 / 3, 0.25, 1.0 / 6, 0.125};
+
+// Engine state for a MIDI channel (~400 bytes so all 16 channels stay cache resident)
+struct channel_state {
+    uint8_t modifier; // Currently selected modifier value
+    uint8_t heldNotes[128]; // Currently held notes, indexed by MIDI note number. For modifier keys this holds 1 if pressed. For play keys this holds the index of chord type when the key was pressed
+    uint8_t heldVelocity[128]; // Velocity of each held play key, indexed by MIDI note number. 0 if not held
+    uint8_t heldChannel[128]; // MIDI channel each held play key was pressed on, indexed by MIDI note number
+    uint8_t arpNote; // Note currently played by arpeggiator, 255 if none
+    uint8_t arpChannel; // MIDI channel of arpeggiator notes (channel of last play key pressed)
+    uint8_t arpVelocity; // Velocity of arpeggiator notes (velocity of last play key pressed)
+    uint32_t arpStep; // Quantity of arpeggiator steps played since play keys were pressed
+    double arpRelease; // Musical position (quarter notes) to release arpNote
+};
 
 struct chord_type {
     const char* name;
@@ -25,9 +64,6 @@ struct chord_type {
 };
 
 // Some constants
-String m_saNoteNames[] = {String("C"),  String("C#"), String("D"),  String("D#"), String("E"),  String("F"),
-                          String("F#"), String("G"),  String("G#"), String("A"),  String("A#"), String("B")};
-
 struct chord_type chords[] = {
     {"None", {0, 255}},
 
@@ -79,16 +115,62 @@ struct chord_type chords[] = {
 
 uint8_t numChords = sizeof(chords)/ sizeof(struct chord_type);
 
+// Enumeration of chord names (excluding "None"), shared by all instances
+static const ParameterEnumerationValue* getChordEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[sizeof(chords) / sizeof(struct chord_type) - 1];
+        table() {
+            for (uint8_t i = 0; i < numChords - 1; ++i) {
+                values[i].label = chords[i + 1].name;
+                values[i].value = i + 1;
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Enumeration of latch mode, shared by all instances
+static const ParameterEnumerationValue* getOnOffEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{0, "off"}, {1, "on"}};
+    return s_values;
+}
+
+// Enumeration of chord transition modes, shared by all instances
+static const ParameterEnumerationValue* getTransitionEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{TRANSITION_RETRIGGER, "Retrigger"}, {TRANSITION_COMMON, "Hold common"}};
+    return s_values;
+}
+
+// Enumeration of channel modes, shared by all instances
+static const ParameterEnumerationValue* getChannelModeEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{CHANNEL_MODE_OMNI, "Omni"}, {CHANNEL_MODE_INDEPENDENT, "Independent"}};
+    return s_values;
+}
+
+// Enumeration of arpeggiator rates, shared by all instances
+static const ParameterEnumerationValue* getArpRateEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{0, "1/1"}, {1, "1/2"}, {2, "1/4"}, {3, "1/8"}, {4, "1/8T"}, {5, "1/16"}, {6, "1/16T"}, {7, "1/32"}};
+    return s_values;
+}
+
+// Enumeration of arpeggiator patterns, shared by all instances
+static const ParameterEnumerationValue* getArpPatternEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{ARP_UP, "Up"}, {ARP_DOWN, "Down"}, {ARP_UP_DOWN, "Up/Down"}, {ARP_RANDOM, "Random"}};
+    return s_values;
+}
+
 // Plugin that creates different chords for each note of an octave played
 class Chordulator : public Plugin {
   public:
     Chordulator()
-        : Plugin(15, // Quantity of parameters
+        : Plugin(27, // Quantity of parameters
                  0,  // Quantity of internal presets (enable DISTRHO_PLUGIN_WANT_PROGRAMS)
                  0   // Quantity of internal states
           ) {
-            for (uint8_t i = 0; i < 128; ++i)
-                m_heldNotes[i] = 0;
+            memset(m_channels, 0, sizeof(m_channels));
+            for (channel_state& state : m_channels)
+                state.arpNote = 255;
           }
 
   protected:
@@ -132,22 +214,15 @@ class Chordulator : public Plugin {
 
     void initParameter(uint32_t index, Parameter& parameter) override {
         if (index < 12) {
-            String sName                            = m_saNoteNames[index] + String(" chord ");
+            String sName                            = String(NOTE_NAMES[index]) + String(" chord ");
             parameter.name                          = sName;
             parameter.symbol                        = sName.replace('#', 's').replace(' ', '_').toLower();
             parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
             parameter.ranges.min                    = 1;
             parameter.ranges.max                    = numChords - 1;
             parameter.ranges.def                    = index + 1;
-            parameter.enumValues.count              = numChords - 1;
-            parameter.enumValues.restrictedMode     = true;
             parameter.groupId                       = 0;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[numChords - 1];
-            for (uint8_t i = 0; i < numChords -1; ++i) {
-                values[i].label = chords[i + 1].name;
-                values[i].value = i + 1;
-            }
-            parameter.enumValues.values = values;
+            setSharedEnumValues(parameter, getChordEnumValues(), numChords - 1);
             m_selectedChord[index + 1] = index + 1;
         } else if (index == 12) {
             parameter.name                          = "Split Point";
@@ -156,15 +231,8 @@ class Chordulator : public Plugin {
             parameter.ranges.min                    = 12;
             parameter.ranges.max                    = 127 - 12;
             parameter.ranges.def                    = 60;
-            parameter.enumValues.count              = 127 - 24;
-            parameter.enumValues.restrictedMode     = true;
             parameter.groupId                       = 1;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[127 - 24];
-            for (uint8_t i = 0; i < 127 - 24; ++i) {
-                values[i].label = m_saNoteNames[i % 12] + String(i / 12 - 1);
-                values[i].value = i;
-            }
-            parameter.enumValues.values = values;
+            setSharedEnumValues(parameter, getNoteEnumValues(), 127 - 24);
         } else if (index == 13){
             parameter.name                          = "Latched";
             parameter.symbol                        = "latched";
@@ -172,15 +240,8 @@ class Chordulator : public Plugin {
             parameter.ranges.min                    = 0;
             parameter.ranges.max                    = 1;
             parameter.ranges.def                    = 0;
-            parameter.enumValues.count              = 2;
-            parameter.enumValues.restrictedMode     = true;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[2];
             parameter.groupId                       = 1;
-            values[0].label = "off";
-            values[0].value = 0;
-            values[1].label = "on";
-            values[1].value = 1;
-            parameter.enumValues.values = values;
+            setSharedEnumValues(parameter, getOnOffEnumValues(), 2);
         } else if (index == 14) {
             parameter.name                          = "Wet";
             parameter.symbol                        = "wet";
@@ -189,6 +250,102 @@ class Chordulator : public Plugin {
             parameter.ranges.max                    = 1.0f;
             parameter.ranges.def                    = 1.0f;
             parameter.groupId                       = 1;
+        } else if (index == 15) {
+            parameter.name                          = "Dropped Events";
+            parameter.symbol                        = "dropped";
+            parameter.hints                         = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1000000;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 1;
+        } else if (index == 16) {
+            parameter.name                          = "Transition";
+            parameter.symbol                        = "transition";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = TRANSITION_RETRIGGER;
+            parameter.ranges.max                    = TRANSITION_COMMON;
+            parameter.ranges.def                    = TRANSITION_RETRIGGER;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getTransitionEnumValues(), 2);
+        } else if (index == 17) {
+            parameter.name                          = "Channel Mode";
+            parameter.symbol                        = "channel_mode";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = CHANNEL_MODE_OMNI;
+            parameter.ranges.max                    = CHANNEL_MODE_INDEPENDENT;
+            parameter.ranges.def                    = CHANNEL_MODE_OMNI;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getChannelModeEnumValues(), 2);
+        } else if (index == 18) {
+            parameter.name                          = "Channel Mask";
+            parameter.symbol                        = "channel_mask";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 0xFFFF;
+            parameter.ranges.def                    = 0xFFFF;
+            parameter.groupId                       = 1;
+        } else if (index == 19) {
+            parameter.name                          = "Arpeggiator";
+            parameter.symbol                        = "arpeggiator";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getOnOffEnumValues(), 2);
+        } else if (index == 20) {
+            parameter.name                          = "Arp Rate";
+            parameter.symbol                        = "arp_rate";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 7;
+            parameter.ranges.def                    = 3;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getArpRateEnumValues(), 8);
+        } else if (index == 21) {
+            parameter.name                          = "Arp Pattern";
+            parameter.symbol                        = "arp_pattern";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = ARP_UP;
+            parameter.ranges.max                    = ARP_RANDOM;
+            parameter.ranges.def                    = ARP_UP;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getArpPatternEnumValues(), 4);
+        } else if (index == 22) {
+            parameter.name                          = "Arp Octaves";
+            parameter.symbol                        = "arp_octaves";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 1;
+            parameter.ranges.max                    = MAX_ARP_OCTAVES;
+            parameter.ranges.def                    = 1;
+            parameter.groupId                       = 1;
+        } else if (index == 23) {
+            parameter.name                          = "Arp Gate";
+            parameter.symbol                        = "arp_gate";
+            parameter.hints                         = kParameterIsAutomatable;
+            parameter.ranges.min                    = 0.05f;
+            parameter.ranges.max                    = 1.0f;
+            parameter.ranges.def                    = 0.5f;
+            parameter.groupId                       = 1;
+        } else if (index == 24) {
+            parameter.initDesignation(kParameterDesignationBypass);
+        } else if (index == 25) {
+            parameter.name                          = "Max Polyphony";
+            parameter.symbol                        = "max_polyphony";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = MAX_POLYPHONY;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 1;
+        } else if (index == 26) {
+            parameter.name                          = "Voice Stealing";
+            parameter.symbol                        = "voice_stealing";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = STEAL_OLDEST;
+            parameter.ranges.max                    = STEAL_HIGHEST;
+            parameter.ranges.def                    = STEAL_OLDEST;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getStealPolicyEnumValues(), 3);
         }
     }
 
@@ -202,6 +359,30 @@ class Chordulator : public Plugin {
             return m_latched;
         else if (index == 14)
             return m_wet;
+        else if (index == 15)
+            return m_midiOut.getDropped();
+        else if (index == 16)
+            return m_transition;
+        else if (index == 17)
+            return m_channelMode;
+        else if (index == 18)
+            return m_channelMask;
+        else if (index == 19)
+            return m_arpeggiator;
+        else if (index == 20)
+            return m_arpRate;
+        else if (index == 21)
+            return m_arpPattern;
+        else if (index == 22)
+            return m_arpOctaves;
+        else if (index == 23)
+            return m_arpGate;
+        else if (index == 24)
+            return m_bypass;
+        else if (index == 25)
+            return m_polyphony;
+        else if (index == 26)
+            return m_stealPolicy;
         return 0.0f;
     }
 
@@ -216,24 +397,72 @@ class Chordulator : public Plugin {
             if (value) {
                 m_latched = 1;
             } else {
-                m_modifier = m_latched = 0;
-                for (uint8_t i = 0; i < 12; ++i) {
-                    if (m_heldNotes[m_splitPoint - 12 + i] != 0) {
-                        m_modifier = m_selectedChord[i + 1];
-                        break;
+                m_latched = 0;
+                for (channel_state& state : m_channels) {
+                    state.modifier = 0;
+                    for (uint8_t i = 0; i < 12; ++i) {
+                        if (state.heldNotes[m_splitPoint - 12 + i] != 0) {
+                            state.modifier = m_selectedChord[i + 1];
+                            break;
+                        }
                     }
                 }
             }
         } else if (index == 14) {
             m_wet = value;
+        } else if (index == 16 && value >= TRANSITION_RETRIGGER && value <= TRANSITION_COMMON) {
+            m_transition = value;
+        } else if (index == 17 && value >= CHANNEL_MODE_OMNI && value <= CHANNEL_MODE_INDEPENDENT) {
+            m_channelMode = value;
+        } else if (index == 18 && value >= 0 && value <= 0xFFFF) {
+            m_channelMask = value;
+        } else if (index == 19 && value >= 0 && value <= 1) {
+            m_arpeggiator = value;
+        } else if (index == 20 && value >= 0 && value <= 7) {
+            m_arpRate = value;
+        } else if (index == 21 && value >= ARP_UP && value <= ARP_RANDOM) {
+            m_arpPattern = value;
+        } else if (index == 22 && value >= 1 && value <= MAX_ARP_OCTAVES) {
+            m_arpOctaves = value;
+        } else if (index == 23 && value >= 0.05f && value <= 1.0f) {
+            m_arpGate = value;
+        } else if (index == 24) {
+            m_bypass = value > 0.5f;
+        } else if (index == 25 && value >= 0 && value <= MAX_POLYPHONY) {
+            m_polyphony = value;
+        } else if (index == 26 && value >= STEAL_OLDEST && value <= STEAL_HIGHEST) {
+            m_stealPolicy = value;
         }
     }
 
-    void sendChordOff(uint8_t note, uint8_t chan, uint32_t frame) {
+    // Check if a chord contains a note offset
+    bool chordHasOffset(uint8_t chordIndex, uint8_t offset) {
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+            if (chords[chordIndex].notes[i] == 255)
+                return false; // A note entry of 255 indicates end of chord
+            if (chords[chordIndex].notes[i] == offset)
+                return true;
+        }
+        return false;
+    }
+
+    void sendChordNote(uint8_t status, uint8_t note, uint8_t velocity, uint32_t frame, bool root = false) {
+        if (note > 127)
+            return;
+        MidiEvent chordEvent;
+        chordEvent.data[0] = status;
+        chordEvent.data[1] = note;
+        chordEvent.data[2] = velocity;
+        chordEvent.frame = frame;
+        chordEvent.size = 3;
+        m_voices.write(this, m_midiOut, chordEvent, root);
+    }
+
+    void sendChordOff(channel_state& state, uint8_t note, uint8_t chan, uint32_t frame) {
         // Send MIDI note-off for each note in chord
         uint8_t chordNote, offset;
         for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
-            offset = chords[m_heldNotes[note]].notes[i];
+            offset = chords[state.heldNotes[note]].notes[i];
             if (offset == 255)
                 break; // A note entry of 255 indicates end of chord
             chordNote = note + offset;
@@ -245,19 +474,22 @@ class Chordulator : public Plugin {
             chordEvent.data[2] = 0;
             chordEvent.frame = frame;
             chordEvent.size = 3;
-            writeMidiEvent(chordEvent);
+            m_voices.write(this, m_midiOut, chordEvent);
         }
-        m_heldNotes[note] = 0;
+        state.heldNotes[note] = 0;
+        state.heldVelocity[note] = 0;
     }
 
-    void sendChordOn(uint8_t note, uint8_t velocity, uint8_t chan, uint32_t frame) {
-        if (m_heldNotes[note])
-            sendChordOff(note, chan, frame);
-        if (m_modifier >= numChords)
+    void sendChordOn(channel_state& state, uint8_t note, uint8_t velocity, uint8_t chan, uint32_t frame) {
+        if (state.heldVelocity[note])
+            sendChordOff(state, note, chan, frame);
+        if (state.modifier >= numChords)
             return;
-        uint8_t chordIndex = m_modifier;
+        uint8_t chordIndex = state.modifier;
         uint8_t chordVel = m_wet * velocity;
-        m_heldNotes[note] = chordIndex;
+        state.heldNotes[note] = chordIndex;
+        state.heldVelocity[note] = velocity;
+        state.heldChannel[note] = chan;
         for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
             uint8_t offset = chords[chordIndex].notes[i];
             if (offset == 255)
@@ -274,64 +506,361 @@ class Chordulator : public Plugin {
                 chordEvent.data[2] = velocity;
             chordEvent.frame = frame;
             chordEvent.size = 3;
-            writeMidiEvent(chordEvent);
+            m_voices.write(this, m_midiOut, chordEvent, i == 0);
+        }
+    }
+
+    // Change a held chord to the current modifier's chord, only sending notes that differ between chords or were stolen
+    void sendChordChange(channel_state& state, uint8_t note, uint8_t chan, uint32_t frame) {
+        if (state.modifier >= numChords)
+            return;
+        uint8_t oldChord = state.heldNotes[note];
+        uint8_t newChord = state.modifier;
+        uint8_t velocity = state.heldVelocity[note];
+        uint8_t chordVel = m_wet * velocity;
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+            uint8_t offset = chords[oldChord].notes[i];
+            if (offset == 255)
+                break;
+            if (!chordHasOffset(newChord, offset))
+                sendChordNote(0x80 + chan, note + offset, 0, frame);
+        }
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+            uint8_t offset = chords[newChord].notes[i];
+            if (offset == 255)
+                break;
+            if (!chordHasOffset(oldChord, offset) || m_voices.isStolen(chan, note + offset))
+                sendChordNote(0x90 + chan, note + offset, i ? chordVel : velocity, frame, i == 0);
+        }
+        state.heldNotes[note] = newChord;
+    }
+
+    // Get the frame within this block of a musical position (quarter notes). Positions before this block return 0.
+    uint32_t getArpFrame(double position) const {
+        double frame = ceil((position - m_arpPosition) * m_arpFramesPerQuarter - 1e-6); // Tolerate rounding error of positions on a frame
+        return frame > 0.0 ? (frame < 0xFFFFFFFF ? frame : 0xFFFFFFFF) : 0;
+    }
+
+    // Update the arpeggiator clock for this block from the host transport, or free run when transport is stopped
+    void updateArpClock() {
+        const TimePosition& timePosition = getTimePosition();
+        const TimePosition::BarBeatTick& bbt = timePosition.bbt;
+        double beatType = (bbt.valid && bbt.beatType > 0) ? bbt.beatType : 4.0;
+        double bpm = (bbt.valid && bbt.beatsPerMinute > 0) ? bbt.beatsPerMinute : 120.0;
+        m_arpFramesPerQuarter = getSampleRate() * 60.0 / bpm * beatType / 4.0;
+        if (timePosition.playing && bbt.valid && bbt.ticksPerBeat > 0) {
+            // Derive position from host each block so there is no accumulated drift
+            double beats = (bbt.barStartTick + bbt.tick) / bbt.ticksPerBeat + bbt.beat - 1;
+            m_arpPosition = beats * 4.0 / beatType;
+            m_arpSynced = true;
+        } else {
+            // Free run from a frame count, anchored where tempo last changed so that position is continuous
+            if (m_arpSynced || m_arpFramesPerQuarter != m_arpFreeFramesPerQuarter) {
+                m_arpFreeAnchor = m_arpSynced ? m_arpPosition : m_arpFreeAnchor + m_arpFreeFrames / m_arpFreeFramesPerQuarter;
+                m_arpFreeFrames = 0;
+                m_arpFreeFramesPerQuarter = m_arpFramesPerQuarter;
+            }
+            m_arpPosition = m_arpFreeAnchor + m_arpFreeFrames / m_arpFreeFramesPerQuarter;
+            m_arpSynced = false;
+        }
+        double stepLength = ARP_RATE_QUARTERS[m_arpRate];
+        m_arpNextStep = ceil(m_arpPosition / stepLength - 1e-9);
+        int64_t prevStep = m_arpNextStep - 1;
+        if (prevStep != m_arpLastStep && (m_arpPosition - prevStep * stepLength) * m_arpFramesPerQuarter < 1.0 - 1e-6)
+            m_arpNextStep = prevStep; // Step fell between last frame of previous block and this block so play at frame 0
+        if (m_arpNextStep == m_arpLastStep)
+            ++m_arpNextStep; // Already played at end of previous block
+    }
+
+    // Move a free running arpeggiator clock so that a step starts at a frame within this block
+    void restartArpClock(uint32_t frame) {
+        if (m_arpSynced)
+            return; // Steps stay aligned to host transport
+        double stepLength = ARP_RATE_QUARTERS[m_arpRate];
+        double position = m_arpPosition + frame / m_arpFramesPerQuarter;
+        double step = ceil(position / stepLength);
+        double offset = step * stepLength - position;
+        m_arpPosition += offset;
+        m_arpFreeAnchor += offset;
+        m_arpNextStep = step;
+        m_arpLastStep = m_arpNextStep - 1;
+    }
+
+    // Get the next note for a channel's arpeggiator from its held chords. Returns 255 if no play keys are held.
+    uint8_t getArpNote(channel_state& state) {
+        uint32_t pool[4] = {0, 0, 0, 0}; // Bitmask of notes available to arpeggiator
+        for (uint8_t i = m_splitPoint; i < 128; ++i) {
+            if (!state.heldVelocity[i])
+                continue;
+            for (uint8_t j = 0; j < MAX_CHORD_NOTES; ++j) {
+                uint8_t offset = chords[state.heldNotes[i]].notes[j];
+                if (offset == 255)
+                    break;
+                for (uint8_t octave = 0; octave < m_arpOctaves; ++octave) {
+                    uint32_t chordNote = i + offset + octave * 12;
+                    if (chordNote < 128)
+                        pool[chordNote >> 5] |= 1 << (chordNote & 31);
+                }
+            }
+        }
+        uint8_t notes[128];
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < 128; ++i)
+            if (pool[i >> 5] & (1 << (i & 31)))
+                notes[count++] = i;
+        if (count == 0) {
+            state.arpStep = 0;
+            return 255;
+        }
+        uint32_t step = state.arpStep++;
+        switch (m_arpPattern) {
+            case ARP_DOWN:
+                return notes[count - 1 - step % count];
+            case ARP_UP_DOWN:
+                if (count < 2)
+                    return notes[0];
+                step %= 2 * (count - 1);
+                return notes[step < count ? step : 2 * (count - 1) - step];
+            case ARP_RANDOM:
+                m_random = m_random * 1664525 + 1013904223;
+                return notes[(m_random >> 16) % count];
+            default:
+                return notes[step % count];
         }
     }
 
+    // Play arpeggiator steps and release arpeggiator notes due within frames [start, end) of this block
+    void runArpeggiator(uint32_t start, uint32_t end) {
+        uint8_t numStates = m_channelModeRunning == CHANNEL_MODE_INDEPENDENT ? 16 : 1;
+        double stepLength = ARP_RATE_QUARTERS[m_arpRate];
+        while (true) {
+            double stepPosition = m_arpNextStep * stepLength;
+            uint32_t stepFrame = getArpFrame(stepPosition);
+            uint32_t releaseFrame = 0xFFFFFFFF;
+            for (uint8_t i = 0; i < numStates; ++i) {
+                if (m_channels[i].arpNote < 128) {
+                    uint32_t frame = getArpFrame(m_channels[i].arpRelease);
+                    if (frame < releaseFrame)
+                        releaseFrame = frame;
+                }
+            }
+            if (releaseFrame <= stepFrame && releaseFrame < end) {
+                // Release notes at end of gate
+                for (uint8_t i = 0; i < numStates; ++i) {
+                    channel_state& state = m_channels[i];
+                    if (state.arpNote < 128 && getArpFrame(state.arpRelease) <= releaseFrame) {
+                        sendChordNote(0x80 + state.arpChannel, state.arpNote, 0, releaseFrame < start ? start : releaseFrame);
+                        state.arpNote = 255;
+                    }
+                }
+                continue;
+            }
+            if (stepFrame >= end)
+                return;
+            if (stepFrame < start)
+                stepFrame = start;
+            // Next step - release notes still sounding then play next note of each channel
+            for (uint8_t i = 0; i < numStates; ++i) {
+                channel_state& state = m_channels[i];
+                if (state.arpNote < 128)
+                    sendChordNote(0x80 + state.arpChannel, state.arpNote, 0, stepFrame);
+                state.arpNote = getArpNote(state);
+                if (state.arpNote > 127)
+                    continue;
+                sendChordNote(0x90 + state.arpChannel, state.arpNote, state.arpVelocity, stepFrame);
+                state.arpRelease = stepPosition + stepLength * m_arpGate;
+            }
+            m_arpLastStep = m_arpNextStep++;
+        }
+    }
+
+    // Switch between chord and arpeggiator modes, moving held play keys to the new mode
+    void setArpeggiatorMode(bool enable) {
+        m_arpRunning = enable;
+        for (channel_state& state : m_channels) {
+            for (uint8_t i = m_splitPoint; i < 128; ++i) {
+                uint8_t velocity = state.heldVelocity[i];
+                if (!velocity)
+                    continue;
+                if (enable) {
+                    uint8_t chordIndex = state.heldNotes[i];
+                    sendChordOff(state, i, state.heldChannel[i], 0);
+                    state.heldNotes[i] = chordIndex;
+                    state.heldVelocity[i] = velocity;
+                } else {
+                    state.heldVelocity[i] = 0;
+                    sendChordOn(state, i, velocity, state.heldChannel[i], 0);
+                }
+            }
+            if (!enable && state.arpNote < 128)
+                sendChordNote(0x80 + state.arpChannel, state.arpNote, 0, 0);
+            state.arpNote = 255;
+            state.arpStep = 0;
+        }
+    }
+
+    // Release all chords and arpeggiator notes and forget held keys
+    void releaseAll() {
+        for (uint8_t chan = 0; chan < 16; ++chan) {
+            channel_state& state = m_channels[chan];
+            for (uint8_t i = m_splitPoint; i < 128; ++i) {
+                if (!state.heldVelocity[i])
+                    continue;
+                if (m_arpRunning) {
+                    state.heldNotes[i] = 0; // Arpeggiator plays held chords so no chord is sounding
+                    state.heldVelocity[i] = 0;
+                } else {
+                    sendChordOff(state, i, state.heldChannel[i], 0);
+                }
+            }
+            if (state.arpNote < 128)
+                sendChordNote(0x80 + state.arpChannel, state.arpNote, 0, 0);
+            state.arpNote = 255;
+            state.arpStep = 0;
+            memset(state.heldNotes, 0, m_splitPoint); // Modifier key releases are not seen while bypassed
+            if (!m_latched)
+                state.modifier = 0;
+        }
+        m_arpHeld = 0;
+    }
+
     // Process audio and MIDI input.
-    void run(const float**, float**, uint32_t, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
+    void run(const float**, float**, uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
         uint8_t status, chan, note, velocity, noteOn, prevModifier;
+        uint32_t arpFrame = 0; // Frame up to which arpeggiator has run
+        m_midiOut.flush(this); // Send events that did not fit in previous cycle
+        if (m_bypass) {
+            // Bypassed - release held chords when entering bypass then pass all events through unprocessed
+            if (!m_bypassRunning) {
+                releaseAll();
+                m_bypassRunning = true;
+            }
+            for (uint32_t j = 0; j < midiEventCount; ++j)
+                m_midiOut.write(this, midiEvents[j]);
+            return;
+        }
+        m_bypassRunning = false;
+        m_voices.configure(this, m_midiOut, m_polyphony, m_stealPolicy);
+        if (m_channelMode != m_channelModeRunning || m_channelMask != m_channelMaskRunning) {
+            // Held keys are in the engine state of the old channel mode or on a channel no longer processed
+            releaseAll();
+            m_channelModeRunning = m_channelMode;
+            m_channelMaskRunning = m_channelMask;
+        }
+        if (m_arpeggiator != m_arpRunning)
+            setArpeggiatorMode(m_arpeggiator);
+        if (m_arpRunning)
+            updateArpClock();
 
         for (uint32_t j = 0; j < midiEventCount; ++j) {
             // Iterate through each MIDI message
-            if (midiEvents[j].kDataSize > 2 && (midiEvents[j].data[0] & 0xE0) == 0x80) {
+            if (m_arpRunning && midiEvents[j].frame > arpFrame) {
+                runArpeggiator(arpFrame, midiEvents[j].frame);
+                arpFrame = midiEvents[j].frame;
+            }
+            if (midiEvents[j].kDataSize > 2 && (midiEvents[j].data[0] & 0xE0) == 0x80 && (m_channelMaskRunning & (1 << (midiEvents[j].data[0] & 0x0f)))) {
                 // Note on/off
-                prevModifier = m_modifier;
                 status = midiEvents[j].data[0];
                 chan = status & 0x0f;
+                channel_state& state = m_channels[m_channelModeRunning == CHANNEL_MODE_INDEPENDENT ? chan : 0];
+                prevModifier = state.modifier;
                 note = midiEvents[j].data[1];
                 velocity = midiEvents[j].data[2];
                 noteOn = ((status & 0x90) == 0x90) && (velocity > 0); // 0 if note-off
 
                 if (note < m_splitPoint) {
                     // Modifier notes
-                    m_heldNotes[note] = noteOn;
+                    state.heldNotes[note] = noteOn;
                     if (!m_latched || (noteOn && (note < m_splitPoint - 12)))
-                        m_modifier = 0;
+                        state.modifier = 0;
                     for (uint8_t i = 0; i < 12; ++i) {
-                        if (m_heldNotes[m_splitPoint - 12 + i] != 0) {
-                            m_modifier = m_selectedChord[i + 1];
+                        if (state.heldNotes[m_splitPoint - 12 + i] != 0) {
+                            state.modifier = m_selectedChord[i + 1];
                             break;
                         }
                     }
-                    if (prevModifier != m_modifier) {
-                        // Modifier changed so reassert currently held notes
+                    if (prevModifier != state.modifier) {
+                        // Modifier changed so reassert currently held notes on the channel each play key was pressed on
                         for (uint8_t i = m_splitPoint; i < 128; ++i) {
-                            if (m_heldNotes[i])
-                                sendChordOn(i, velocity, chan, midiEvents[j].frame);
+                            if (!state.heldVelocity[i])
+                                continue;
+                            if (m_arpRunning) {
+                                if (state.modifier < numChords)
+                                    state.heldNotes[i] = state.modifier; // Arpeggiator plays new chord from next step
+                            } else if (m_transition == TRANSITION_COMMON)
+                                sendChordChange(state, i, state.heldChannel[i], midiEvents[j].frame);
+                            else
+                                sendChordOn(state, i, state.heldVelocity[i], state.heldChannel[i], midiEvents[j].frame);
                         }
                     }
                 } else {
                     // Play notes
-                    if (noteOn) {
-                        sendChordOn(note, velocity, chan, midiEvents[j].frame);
+                    bool wasHeld = state.heldVelocity[note];
+                    if (m_arpRunning) {
+                        // Arpeggiator plays held chords
+                        if (noteOn && state.modifier < numChords) {
+                            if (m_arpHeld == 0)
+                                restartArpClock(midiEvents[j].frame);
+                            state.heldNotes[note] = state.modifier;
+                            state.heldVelocity[note] = velocity;
+                            state.heldChannel[note] = chan;
+                            state.arpVelocity = velocity;
+                            state.arpChannel = chan;
+                        } else if (!noteOn) {
+                            state.heldNotes[note] = 0;
+                            state.heldVelocity[note] = 0;
+                        }
+                    } else if (noteOn) {
+                        state.arpChannel = chan;
+                        sendChordOn(state, note, velocity, chan, midiEvents[j].frame);
                     } else {
-                        // Release note - send associated MIDI note-off messages
-                        sendChordOff(note, chan, midiEvents[j].frame);
+                        // Release note - send associated MIDI note-off messages on the channel the chord was played on
+                        sendChordOff(state, note, wasHeld ? state.heldChannel[note] : chan, midiEvents[j].frame);
                     }
+                    m_arpHeld += (state.heldVelocity[note] != 0) - wasHeld;
                 }
             } else
-                writeMidiEvent(midiEvents[j]); // Pass through unprocessed MIDI data
+                m_voices.write(this, m_midiOut, midiEvents[j]); // Pass through unprocessed MIDI data
+        }
+        if (m_arpRunning) {
+            runArpeggiator(arpFrame, frames);
+            m_arpFreeFrames += frames;
         }
     }
 
   private:
-    uint8_t m_modifier = 0; // Currently selected modifier value
     uint8_t m_splitPoint = 60; // MIDI note number of start of right hand (play) keys
     uint8_t m_selectedChord[13]; // Index of the chord for each modifier key when in chord mode. Index 0 is bypass (no chord)
-    uint8_t m_heldNotes[128]; // Currently held notes, indexed by MIDI note number. For modifier keys this holds 1 if pressed. For play keys this holds the index of chord type when the key was pressed 
+    channel_state m_channels[16]; // Engine state for each MIDI channel. Only first is used in omni mode
+    uint8_t m_channelMode = CHANNEL_MODE_OMNI; // How MIDI channels share engine state (CHANNEL_MODES)
+    uint16_t m_channelMask = 0xFFFF; // Bitmask of MIDI channels processed. Other channels pass through unchanged
+    uint8_t m_channelModeRunning = CHANNEL_MODE_OMNI; // Channel mode used by run() (follows m_channelMode at start of run() cycle)
+    uint16_t m_channelMaskRunning = 0xFFFF; // Channel mask used by run() (follows m_channelMask at start of run() cycle)
     uint8_t m_latched = 0; // True to latch selected chord.
+    uint8_t m_transition = TRANSITION_RETRIGGER; // How held chords change when modifier changes (TRANSITION_MODES)
     float m_wet = 1.0f; // Mix of chord to root note
+    bool m_bypass = false; // True to pass all MIDI through unprocessed
+    bool m_bypassRunning = false; // True if run() has released held chords for bypass
+    uint8_t m_arpeggiator = 0; // True to play held chords as arpeggio
+    uint8_t m_arpRunning = 0; // True if arpeggiator is running (follows m_arpeggiator at start of run() cycle)
+    uint8_t m_arpRate = 3; // Index of arpeggiator step length in ARP_RATE_QUARTERS
+    uint8_t m_arpPattern = ARP_UP; // Order arpeggiator plays notes (ARP_PATTERNS)
+    uint8_t m_arpOctaves = 1; // Quantity of octaves arpeggiator spans
+    float m_arpGate = 0.5f; // Length of arpeggiator notes as proportion of step length
+    uint16_t m_arpHeld = 0; // Quantity of play keys held on all channels
+    uint32_t m_random = 1; // Pseudo random number generator state for random arpeggiator pattern
+    double m_arpPosition = 0.0; // Musical position (quarter notes) at start of current block
+    double m_arpFramesPerQuarter = 24000.0; // Frames per quarter note at current tempo
+    int64_t m_arpNextStep = 0; // Index of next arpeggiator step (position / step length)
+    int64_t m_arpLastStep = -1; // Index of last arpeggiator step played
+    bool m_arpSynced = false; // True if arpeggiator clock follows host transport
+    double m_arpFreeAnchor = 0.0; // Free running clock position (quarter notes) at last tempo change
+    double m_arpFreeFramesPerQuarter = 24000.0; // Free running clock frames per quarter note since last tempo change
+    uint64_t m_arpFreeFrames = 0; // Frames since last tempo change while free running
+    uint16_t m_polyphony = 0; // Maximum quantity of notes sounding at output. 0 for unlimited
+    uint8_t m_stealPolicy = STEAL_OLDEST; // Which note is released to play a note above polyphony limit (STEAL_POLICIES)
+    VoiceLimiter m_voices; // Notes sounding at output, used to enforce polyphony limit
+    MidiOutQueue m_midiOut; // Events waiting for space in host output buffer
 
     // Set our plugin class as non-copyable and add a leak detector just in case.
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Chordulator)
@@ -14,16 +14,107 @@
  */
 
 #include "DistrhoPlugin.hpp"
+#include "EnumTables.hpp"
+#include "MidiOutQueue.hpp"
+#include "TimedEventQueue.hpp"
+#include "TripleBuffer.hpp"
+#include "VoiceLimiter.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #define MAX_NOTES 4 // Maximum notes in a chord
+#define STOLEN_NOTE 0xFE // Held note entry of a chord note released by voice stealing
 #define NUM_PRESETS sizeof(CHORDS) / MAX_NOTES // Quantity of preset chords
 #define NUM_PARAMS 24 * MAX_NOTES + 1
+#define NUM_MAP_VALUES 24 * MAX_NOTES // Quantity of offset and velocity values in chord map
+#ifdef MULTICHORD_STATE_MAP
+// Chord map is a single state (see MultiChordMap). Only these parameters are exposed as control ports.
+#define PARAM_WET 0
+#define PARAM_DROPPED 1
+#define PARAM_OVERLAP 2
+#define PARAM_PRESET 3
+#define PARAM_STRUM 4
+#define PARAM_STRUM_ORDER 5
+#define PARAM_POLYPHONY 6
+#define PARAM_STEAL_POLICY 7
+#define NUM_PORTS 8
+#define NUM_STATES 1
+#else
+#define PARAM_WET NUM_PARAMS - 1
+#define PARAM_DROPPED NUM_PARAMS // Output parameter index, not stored in m_fParamValues
+#define PARAM_OVERLAP NUM_PARAMS + 1 // Overlapping note policy parameter index, not stored in m_fParamValues
+#define PARAM_STRUM NUM_PARAMS + 2 // Strum time parameter index, not stored in m_fParamValues
+#define PARAM_STRUM_ORDER NUM_PARAMS + 3 // Strum order parameter index, not stored in m_fParamValues
+#define PARAM_POLYPHONY NUM_PARAMS + 4 // Polyphony limit parameter index, not stored in m_fParamValues
+#define PARAM_STEAL_POLICY NUM_PARAMS + 5 // Voice stealing policy parameter index, not stored in m_fParamValues
+#define NUM_PORTS NUM_PARAMS + 6
+#define NUM_STATES 0
+#endif
+#define VELOCITY_SHIFT 16 // Fixed point velocity scale: 1 << VELOCITY_SHIFT is unity
+#define MAX_STRUM 200 // Maximum delay between strummed chord notes in milliseconds
+#define STRUM_QUEUE_SIZE (128 * (MAX_NOTES - 1) * 4) // Maximum quantity of strummed notes waiting to be sent - enough for a strummed chord on every trigger of 4 channels at once. Notes play immediately when full.
 
 START_NAMESPACE_DISTRHO
 
-// Some constant strings used in naming elements
-String m_saNoteNames[] = {String("C"),  String("C#"), String("D"),  String("D#"), String("E"),  String("F"),
-                          String("F#"), String("G"),  String("G#"), String("A"),  String("A#"), String("B")};
+// Enumeration of note offsets named by resulting note for each of 12 chord roots, shared by all instances
+static const ParameterEnumerationValue* getOffsetEnumValues(uint32_t root) {
+    struct table {
+        ParameterEnumerationValue values[12][49];
+        table() {
+            for (uint32_t root = 0; root < 12; ++root) {
+                for (int i = -24; i < 25; ++i) {
+                    String sPrefix("");
+                    if (i < -23)
+                        sPrefix = "-3";
+                    else if (i < -11)
+                        sPrefix = "-2";
+                    else if (i < 0)
+                        sPrefix = "-";
+                    else if (i > 23)
+                        sPrefix = "+3";
+                    else if (i > 11)
+                        sPrefix = "+2";
+                    else if (i > 0)
+                        sPrefix = "+";
+                    values[root][i + 24].label = sPrefix + NOTE_NAMES[(root + 24 + i) % 12];
+                    values[root][i + 24].value = i;
+                }
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values[root];
+}
+
+enum OVERLAP_MODES {
+    OVERLAP_MERGE     = 0, // Only send note-on for first chord to use a note and note-off for last to release it
+    OVERLAP_RETRIGGER = 1  // Send note-on for each chord that uses a note, note-off when last chord releases it
+};
+
+// Enumeration of overlapping note policy, shared by all instances
+static const ParameterEnumerationValue* getOverlapEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{OVERLAP_MERGE, "Merge"}, {OVERLAP_RETRIGGER, "Retrigger"}};
+    return s_values;
+}
+
+enum STRUM_ORDERS {
+    STRUM_UP     = 0, // Strum from lowest to highest note
+    STRUM_DOWN   = 1, // Strum from highest to lowest note
+    STRUM_RANDOM = 2  // Strum notes in a different random order each time
+};
+
+// Enumeration of strum orders, shared by all instances
+static const ParameterEnumerationValue* getStrumOrderEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{STRUM_UP, "Up"}, {STRUM_DOWN, "Down"}, {STRUM_RANDOM, "Random"}};
+    return s_values;
+}
+
+static const char* const PRESET_NAMES[] = {"No chord", "Major triad", "Minor triad", "Diminishsed", "Augmented", "Major 7th", "Minor 7th",
+                                           "Dominant 7th", "Half diminished 7th", "Diminished 7th", "Minor-Major 7th", "Augmented Major 7th",
+                                           "Augmented 7th", "Suspended 2nd", "Suspended 4nd", "7sus4", "Add9", "Minor Add9", "Major 6th", "Minor 6th",
+                                           "Half-Diminished Dominant"};
 
 char CHORDS[][MAX_NOTES] = {
     {0, 0, 0, 0}, // No chord
@@ -55,18 +146,75 @@ char CHORDS[][MAX_NOTES] = {
     {0, 4, 6, 10} // Half-Diminished Dominant
 };
 
+#ifdef MULTICHORD_STATE_MAP
+// Enumeration of presets, shared by all instances
+static const ParameterEnumerationValue* getPresetEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[NUM_PRESETS];
+        table() {
+            for (uint32_t i = 0; i < NUM_PRESETS; ++i) {
+                values[i].label = PRESET_NAMES[i];
+                values[i].value = i;
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Chord map parsed from state, passed to the audio thread, or loaded from a preset, passed back to getState()
+struct chord_map_state {
+    float values[NUM_MAP_VALUES]; // Offsets then velocities, same layout as m_fParamValues
+    uint8_t preset; // Index of preset selected when map was saved
+    uint32_t sequence; // Quantity of states set before this map (state) or before the preset was loaded (preset)
+};
+#endif
+
+// Chord compiled from parameters for a single trigger note, ready to send
+struct chord_map_entry {
+    uint8_t count; // Quantity of notes in chord (out of range and duplicate root notes removed)
+    uint8_t notes[MAX_NOTES]; // MIDI note number of each chord note
+    uint32_t velocity[MAX_NOTES]; // Velocity scale of each chord note (fixed point, including wet)
+};
+
+// Chord note waiting to be sent by strum
+struct strum_note {
+    uint16_t generation; // Generation of trigger when scheduled - note is discarded if trigger has since been released or retriggered
+    uint8_t status; // Note-on status byte (including channel)
+    uint8_t trigger; // Trigger note that played the chord
+    uint8_t note; // MIDI note number to send
+    uint8_t velocity; // Velocity to send
+    bool root; // True if note is the chord root
+};
+
 // Plugin that creates different chords for each note of an octave played
 class MultiChord : public Plugin {
   public:
     MultiChord()
-        : Plugin(NUM_PARAMS,  // Quantity of parameters
+        : Plugin(NUM_PORTS,   // Quantity of parameters
                  NUM_PRESETS, // Quantity of internal presets (enable DISTRHO_PLUGIN_WANT_PROGRAMS)
-                 0            // Quantity of internal states
-          ) {}
+                 NUM_STATES   // Quantity of internal states
+          ) {
+            for (int i = 0; i < 12 * MAX_NOTES; ++i) {
+                m_fParamValues[i] = 0.0f;
+                m_fParamValues[i + 12 * MAX_NOTES] = 1.0f;
+            }
+            m_fParamValues[m_nWet] = 1.0f;
+            compileChordMap();
+            memset(m_noteRefs, 0, sizeof(m_noteRefs));
+            memset(m_heldNotes, 0xFF, sizeof(m_heldNotes));
+            memset(m_noteHolders, 0, sizeof(m_noteHolders));
+            memset(m_triggerGeneration, 0, sizeof(m_triggerGeneration));
+            m_voices.setStealCallback([](void* context, uint8_t channel, uint8_t note) { static_cast<MultiChord*>(context)->forgetNote(channel, note); }, this);
+          }
 
   protected:
     // Get the plugin label. Short restricted name consisting of only _, a-z, A-Z and 0-9 characters.
+#ifdef MULTICHORD_STATE_MAP
+    const char* getLabel() const override { return "MultiChordMap"; }
+#else
     const char* getLabel() const override { return "MultiChord"; }
+#endif
 
     // Get an full description about the plugin.
     const char* getDescription() const override { return "Plugin that creates different chords for each note of the octave"; }
@@ -86,18 +234,22 @@ class MultiChord : public Plugin {
     // Get the plugin unique Id. Used by LADSPA, DSSI and VST plugin formats.
     int64_t getUniqueId() const override {
         int64_t nValue = ('r' << 24) | ('i' << 16) | ('b' << 8) | ('a' << 0);
+#ifdef MULTICHORD_STATE_MAP
+        return (nValue << 32) | ('n' << 24) | 4;
+#else
         return (nValue << 32) | ('n' << 24) | 1;
+#endif
     }
 
     // Inititialise controls and parameters.
     void initPortGroup(const uint32_t groupId, PortGroup& portGroup)
     {
         if (groupId < 12) {
-            portGroup.name = String("Offset ") + m_saNoteNames[groupId];
-            portGroup.symbol = String("offset_") + m_saNoteNames[groupId];
+            portGroup.name = String("Offset ") + NOTE_NAMES[groupId];
+            portGroup.symbol = String("offset_") + NOTE_NAMES[groupId];
         } else if (groupId < 24) {
-            portGroup.name = String("Velocity ") + m_saNoteNames[groupId - 12];
-            portGroup.symbol = String("velocity_") + m_saNoteNames[groupId - 12];
+            portGroup.name = String("Velocity ") + NOTE_NAMES[groupId - 12];
+            portGroup.symbol = String("velocity_") + NOTE_NAMES[groupId - 12];
         } else if (groupId == 24) {
             portGroup.name = String("Config");
             portGroup.symbol = String("vconfig");
@@ -106,7 +258,7 @@ class MultiChord : public Plugin {
     }
 
     void initParameter(uint32_t index, Parameter& parameter) override {
-        if (index == m_nWet) {
+        if (index == PARAM_WET) {
             // Implement wet/dry control
             parameter.name                          = "Wet";
             parameter.symbol                        = "wet";
@@ -117,44 +269,98 @@ class MultiChord : public Plugin {
             parameter.enumValues.restrictedMode     = true;
             parameter.groupId                       = 24;
             return;
+        } else if (index == PARAM_DROPPED) {
+            parameter.name                          = "Dropped Events";
+            parameter.symbol                        = "dropped";
+            parameter.hints                         = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1000000;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 24;
+            return;
+        } else if (index == PARAM_OVERLAP) {
+            parameter.name                          = "Overlap";
+            parameter.symbol                        = "overlap";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = OVERLAP_MERGE;
+            parameter.ranges.max                    = OVERLAP_RETRIGGER;
+            parameter.ranges.def                    = OVERLAP_MERGE;
+            parameter.groupId                       = 24;
+            setSharedEnumValues(parameter, getOverlapEnumValues(), 2);
+            return;
+        } else if (index == PARAM_STRUM) {
+            parameter.name                          = "Strum";
+            parameter.symbol                        = "strum";
+            parameter.unit                          = "ms";
+            parameter.hints                         = kParameterIsAutomatable;
+            parameter.ranges.min                    = 0.0f;
+            parameter.ranges.max                    = MAX_STRUM;
+            parameter.ranges.def                    = 0.0f;
+            parameter.groupId                       = 24;
+            return;
+        } else if (index == PARAM_STRUM_ORDER) {
+            parameter.name                          = "Strum Order";
+            parameter.symbol                        = "strum_order";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = STRUM_UP;
+            parameter.ranges.max                    = STRUM_RANDOM;
+            parameter.ranges.def                    = STRUM_UP;
+            parameter.groupId                       = 24;
+            setSharedEnumValues(parameter, getStrumOrderEnumValues(), 3);
+            return;
+        } else if (index == PARAM_POLYPHONY) {
+            parameter.name                          = "Max Polyphony";
+            parameter.symbol                        = "max_polyphony";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = MAX_POLYPHONY;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 24;
+            return;
+        } else if (index == PARAM_STEAL_POLICY) {
+            parameter.name                          = "Voice Stealing";
+            parameter.symbol                        = "voice_stealing";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = STEAL_OLDEST;
+            parameter.ranges.max                    = STEAL_HIGHEST;
+            parameter.ranges.def                    = STEAL_OLDEST;
+            parameter.groupId                       = 24;
+            setSharedEnumValues(parameter, getStealPolicyEnumValues(), 3);
+            return;
+#ifdef MULTICHORD_STATE_MAP
+        } else if (index == PARAM_PRESET) {
+            parameter.name                          = "Preset";
+            parameter.symbol                        = "preset";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = NUM_PRESETS - 1;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 24;
+            setSharedEnumValues(parameter, getPresetEnumValues(), NUM_PRESETS);
+            return;
+        } else {
+            return; // Chord map is held in state, not parameters
+        }
+#else
         } else if (index >= NUM_PARAMS)
             return;
+#endif
         uint32_t nNote  = index % MAX_NOTES;
         uint32_t nChord = (index / MAX_NOTES) % 12;
         String sName;
         if (index < 12 * MAX_NOTES) {
             // Note map
-            sName                                   = String("Offset ") + m_saNoteNames[nChord] + String(nNote + 1);
+            sName                                   = String("Offset ") + NOTE_NAMES[nChord] + String(nNote + 1);
             parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
             parameter.ranges.min                    = -24.0f;
             parameter.ranges.max                    = 24.0f;
             parameter.ranges.def                    = 0.0f;
-            parameter.enumValues.count              = 49;
-            parameter.enumValues.restrictedMode     = true;
             parameter.groupId                       = nChord;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[49];
-            for (int i = -24; i < 25; ++i) {
-                String sPrefix("");
-                if (i < -23)
-                    sPrefix = "-3";
-                else if (i < -11)
-                    sPrefix = "-2";
-                else if (i < 0)
-                    sPrefix = "-";
-                else if (i > 23)
-                    sPrefix = "+3";
-                else if (i > 11)
-                    sPrefix = "+2";
-                else if (i > 0)
-                    sPrefix = "+";
-                values[i + 24].label = sPrefix + m_saNoteNames[(nChord + 24 + i) % 12];
-                values[i + 24].value = i;
-            }
-            parameter.enumValues.values = values;
+            setSharedEnumValues(parameter, getOffsetEnumValues(nChord), 49);
             m_fParamValues[index]       = 0.0f;
         } else {
             // Velocity map
-            sName                 = String("Velocity ") + m_saNoteNames[nChord] + String(nNote + 1);
+            sName                 = String("Velocity ") + NOTE_NAMES[nChord] + String(nNote + 1);
             parameter.hints       = kParameterIsAutomatable;
             parameter.ranges.min  = 0.0f;
             parameter.ranges.max  = 2.0f;
@@ -170,27 +376,186 @@ class MultiChord : public Plugin {
     void initProgramName(uint32_t index, String& programName) {
         if (index >= NUM_PRESETS)
             return;
-        const char* names[] = {"No chord", "Major triad", "Minor triad", "Diminishsed", "Augmented", "Major 7th", "Minor 7th", "Dominant 7th", "Half diminished 7th", "Diminished 7th", "Minor-Major 7th", "Augmented Major 7th", "Augmented 7th", "Suspended 2nd", "Suspended 4nd", "7sus4", "Add9", "Minor Add9", "Major 6th", "Minor 6th", "Half-Diminished Dominant"};
-        programName = names[index];
+        programName = PRESET_NAMES[index];
+    }
+
+#ifdef MULTICHORD_STATE_MAP
+    // Initialise state.
+    void initState(uint32_t index, State& state) override {
+        if (index != 0)
+            return;
+        state.key          = "chord_map";
+        state.label        = "Chord map";
+        state.description  = "Preset, then offset and velocity (percent) of each chord note for each note of the octave";
+        state.hints        = kStateIsHostWritable;
+        state.defaultValue = formatChordMap(m_fParamValues, 0);
+        memcpy(m_stateMap.values, m_fParamValues, sizeof(m_stateMap.values));
+        m_stateMap.preset   = 0;
+        m_stateMap.sequence = 0;
+    }
+
+    // Get the chord map as a compact string: "preset|o1,o2,o3,o4,v1,v2,v3,v4;..." with a group for each note of the octave
+    static String formatChordMap(const float* values, uint8_t preset) {
+        char buffer[24 * MAX_NOTES * 5 + 32];
+        int len = snprintf(buffer, sizeof(buffer), "%u|", preset);
+        for (uint8_t base_note = 0; base_note < 12; ++base_note) {
+            for (uint8_t i = 0; i < MAX_NOTES; ++i)
+                len += snprintf(buffer + len, sizeof(buffer) - len, "%d,", (int)values[base_note * MAX_NOTES + i]);
+            for (uint8_t i = 0; i < MAX_NOTES; ++i)
+                len += snprintf(buffer + len, sizeof(buffer) - len, "%d,", (int)(values[(12 + base_note) * MAX_NOTES + i] * 100 + 0.5f));
+            buffer[len - 1] = ';'; // Replace trailing comma with group separator
+        }
+        buffer[len - 1] = 0; // Remove trailing group separator
+        return String(buffer);
+    }
+
+    // Parse a chord map string (see formatChordMap) into a state. Missing values are set to default. Returns false if malformed.
+    static bool parseChordMap(const char* text, chord_map_state& state) {
+        for (uint8_t i = 0; i < 12 * MAX_NOTES; ++i) {
+            state.values[i]                  = 0.0f;
+            state.values[i + 12 * MAX_NOTES] = 1.0f;
+        }
+        state.preset = 0;
+        const char* sep = strchr(text, '|');
+        if (sep) {
+            int preset = atoi(text);
+            if (preset >= 0 && preset < (int)NUM_PRESETS)
+                state.preset = preset;
+            text = sep + 1;
+        }
+        for (uint8_t base_note = 0; base_note < 12 && *text; ++base_note) {
+            for (uint8_t i = 0; i < MAX_NOTES * 2 && *text && *text != ';'; ++i) {
+                char* end;
+                long value = strtol(text, &end, 10);
+                if (end == text)
+                    return false;
+                if (i < MAX_NOTES)
+                    state.values[base_note * MAX_NOTES + i] = value < -24 ? -24 : value > 24 ? 24 : value;
+                else
+                    state.values[(12 + base_note) * MAX_NOTES + i - MAX_NOTES] = (value < 0 ? 0 : value > 200 ? 200 : value) / 100.0f;
+                text = end;
+                if (*text == ',')
+                    ++text;
+            }
+            if (*text == ';')
+                ++text;
+        }
+        return true;
+    }
+
+    // Set chord map from state. Parsed here (not audio thread) and passed to run() without blocking.
+    void setState(const char* key, const char* value) override {
+        if (strcmp(key, "chord_map") != 0)
+            return;
+        chord_map_state& state = m_mapState.getWriteBuffer();
+        if (!parseChordMap(value, state))
+            return;
+        state.sequence = ++m_stateSequence;
+        m_stateMap     = state;
+        m_mapState.publish();
+    }
+
+    // Apply chord map state set since last call, if any. Call from audio thread.
+    void applyMapState() {
+        if (!m_mapState.consume())
+            return;
+        const chord_map_state& state = m_mapState.getReadBuffer();
+        memcpy(m_fParamValues, state.values, sizeof(state.values));
+        m_preset            = state.preset;
+        m_appliedSequence   = state.sequence;
+        m_dirtyPitchClasses = 0xFFF;
+    }
+
+    // Pass the chord map loaded from a preset to getState(). Call from audio thread.
+    void publishPresetMap() {
+        chord_map_state& state = m_presetMap.getWriteBuffer();
+        memcpy(state.values, m_fParamValues, sizeof(state.values));
+        state.preset   = m_preset;
+        state.sequence = m_appliedSequence;
+        m_presetMap.publish();
+    }
+
+    /*  Get current chord map. Formatted from a copy owned by this (non-audio) thread: the last state set, or a preset
+        loaded since, unless a newer state was set before the audio thread loaded the preset (it will replace the preset).
+    */
+    String getState(const char* key) const override {
+        if (strcmp(key, "chord_map") != 0)
+            return String();
+        if (m_presetMap.consume() && m_presetMap.getReadBuffer().sequence == m_stateSequence)
+            m_stateMap = m_presetMap.getReadBuffer();
+        return formatChordMap(m_stateMap.values, m_stateMap.preset);
     }
+#endif
 
     // Get a value from a control or parameter
     float getParameterValue(uint32_t index) const override {
+        if (index == PARAM_WET)
+            return m_fParamValues[m_nWet];
+        if (index == PARAM_DROPPED)
+            return m_midiOut.getDropped();
+        if (index == PARAM_OVERLAP)
+            return m_overlap;
+        if (index == PARAM_STRUM)
+            return m_strum;
+        if (index == PARAM_STRUM_ORDER)
+            return m_strumOrder;
+        if (index == PARAM_POLYPHONY)
+            return m_polyphony;
+        if (index == PARAM_STEAL_POLICY)
+            return m_stealPolicy;
+#ifdef MULTICHORD_STATE_MAP
+        if (index == PARAM_PRESET)
+            return m_preset;
+#else
         if (index < NUM_PARAMS)
             return m_fParamValues[index];
+#endif
         return 0.0f;
     }
 
     // Set a control or parameter value
     void setParameterValue(uint32_t index, float value) override {
-        if (index < NUM_PARAMS)
-            m_fParamValues[index] = value;
+        if (index == PARAM_OVERLAP && value >= OVERLAP_MERGE && value <= OVERLAP_RETRIGGER)
+            m_overlap = value;
+        else if (index == PARAM_STRUM && value >= 0.0f && value <= MAX_STRUM)
+            m_strum = value;
+        else if (index == PARAM_STRUM_ORDER && value >= STRUM_UP && value <= STRUM_RANDOM)
+            m_strumOrder = value;
+        else if (index == PARAM_POLYPHONY && value >= 0 && value <= MAX_POLYPHONY)
+            m_polyphony = value;
+        else if (index == PARAM_STEAL_POLICY && value >= STEAL_OLDEST && value <= STEAL_HIGHEST)
+            m_stealPolicy = value;
+#ifdef MULTICHORD_STATE_MAP
+        if (index == PARAM_WET) {
+            m_fParamValues[m_nWet] = value;
+            m_dirtyPitchClasses    = 0xFFF;
+        } else if (index == PARAM_PRESET) {
+            // Preset port may be restored with state - do not load the preset saved in state over its (edited) map
+            // A write of the current port value is an explicit reload
+            applyMapState();
+            bool restore = value != m_presetPort && value == m_preset;
+            m_presetPort = value;
+            if (!restore)
+                loadProgram(value);
+        }
+        return;
+#endif
+        if (index >= NUM_PARAMS)
+            return;
+        m_fParamValues[index] = value;
+        if (index == m_nWet)
+            m_dirtyPitchClasses = 0xFFF;
+        else
+            m_dirtyPitchClasses |= 1 << ((index / MAX_NOTES) % 12);
     }
 
     // Load a preset (called program in DPF).
     void loadProgram(uint32_t index) {
         if (index >= NUM_PRESETS)
             return;
+#ifdef MULTICHORD_STATE_MAP
+        applyMapState(); // Apply older state now so that it does not replace this preset
+#endif
         for (int i = 0; i < 12; ++i) {
             for (int j = 0; j < MAX_NOTES; ++j) {
                 m_fParamValues[i * MAX_NOTES + j] = CHORDS[index][j];
@@ -198,47 +563,264 @@ class MultiChord : public Plugin {
             }
         }
         m_fParamValues[m_nWet] = 1.0f;
+        m_dirtyPitchClasses    = 0xFFF;
+        m_preset               = index;
+#ifdef MULTICHORD_STATE_MAP
+        publishPresetMap();
+#endif
+    }
+
+    // Rebuild the chord map entry for a trigger note from the current parameter values
+    void compileChord(uint8_t note) {
+        chord_map_entry& chord = m_chordMap[note];
+        uint8_t base_note      = note % 12;
+        int root               = m_fParamValues[base_note * MAX_NOTES];
+        chord.count            = 0;
+        for (int i = 0; i < MAX_NOTES; ++i) {
+            int nParam = base_note * MAX_NOTES + i;
+            int offset = m_fParamValues[nParam];
+            if (i > 0 && offset == root)
+                continue; // Skip if note not configured (same as root note)
+            int chordNote = note + offset;
+            if (chordNote > 127 || chordNote < 0)
+                continue; // Transposed note is out of range
+            float scale = m_fParamValues[nParam + 12 * MAX_NOTES];
+            if (i)
+                scale *= m_fParamValues[m_nWet];
+            if (scale < 0.0f)
+                scale = 0.0f;
+            chord.notes[chord.count]    = chordNote;
+            chord.velocity[chord.count] = scale * (1 << VELOCITY_SHIFT) + 0.5f;
+            ++chord.count;
+        }
+    }
+
+    // Rebuild the chord map entries for each trigger note of a pitch class (0..11)
+    void compilePitchClass(uint8_t base_note) {
+        for (uint8_t note = base_note; note < 128; note += 12)
+            compileChord(note);
+    }
+
+    // Rebuild the chord map entries of pitch classes changed since last rebuild
+    void compileChordMap() {
+        for (uint8_t base_note = 0; base_note < 12; ++base_note)
+            if (m_dirtyPitchClasses & (1 << base_note))
+                compilePitchClass(base_note);
+        m_dirtyPitchClasses = 0;
+    }
+
+    // Release the chord sounding for a trigger note, sending note-off only for notes no other chord holds
+    // chordEvent is a copy of the trigger event, modified for each chord note sent
+    void releaseChord(MidiEvent& chordEvent, uint8_t channel, uint8_t trigger) {
+        uint8_t* held = m_heldNotes[channel][trigger];
+        if ((chordEvent.data[0] & 0xF0) == 0x90 && chordEvent.data[2]) {
+            // Released by repeated note-on
+            chordEvent.data[0] = 0x80 | channel;
+            chordEvent.data[2] = 0;
+        }
+        for (uint8_t i = 0; i < MAX_NOTES && held[i] != 0xFF; ++i) {
+            uint8_t note = held[i];
+            held[i]      = 0xFF;
+            if (note == STOLEN_NOTE)
+                continue; // Note-off sent when voice was stolen
+            m_noteHolders[channel][note][trigger >> 5] &= ~(1u << (trigger & 31));
+            if (m_noteRefs[channel][note] && --m_noteRefs[channel][note])
+                continue; // Note still held by another chord
+            chordEvent.data[1] = note;
+            m_voices.write(this, m_midiOut, chordEvent);
+        }
+    }
+
+    // Add a note to the chord notes held for a trigger
+    void holdNote(uint8_t channel, uint8_t trigger, uint8_t slot, uint8_t note) {
+        m_heldNotes[channel][trigger][slot] = note;
+        m_noteHolders[channel][note][trigger >> 5] |= 1u << (trigger & 31);
+    }
+
+    // Forget a chord note released by voice stealing so that no chord sends its note-off and the next chord using it sends note-on.
+    // Only the triggers whose chords hold the note are visited.
+    void forgetNote(uint8_t channel, uint8_t note) {
+        if (m_noteRefs[channel][note] == 0)
+            return;
+        m_noteRefs[channel][note] = 0;
+        uint32_t* holders = m_noteHolders[channel][note];
+        for (uint8_t i = 0; i < 4; ++i) {
+            for (uint32_t bits = holders[i]; bits; bits &= bits - 1) {
+                uint8_t* held = m_heldNotes[channel][i * 32 + __builtin_ctz(bits)];
+                for (uint8_t j = 0; j < MAX_NOTES && held[j] != 0xFF; ++j)
+                    if (held[j] == note)
+                        held[j] = STOLEN_NOTE;
+            }
+            holders[i] = 0;
+        }
+    }
+
+    // Start a chord note, sending note-on only if not already held by another chord (unless retriggering)
+    // chordEvent is a note-on event, modified for the chord note sent. Returns false if note could not be held.
+    bool startNote(MidiEvent& chordEvent, uint8_t channel, uint8_t note, uint8_t velocity, bool root) {
+        if (m_noteRefs[channel][note] == 255)
+            return false; // Too many chords hold this note
+        if (m_noteRefs[channel][note]++ == 0 || m_overlap == OVERLAP_RETRIGGER) {
+            chordEvent.data[1] = note;
+            chordEvent.data[2] = velocity;
+            m_voices.write(this, m_midiOut, chordEvent, root);
+        }
+        return true;
+    }
+
+    // Play the chord for a trigger note. Notes after the first are scheduled at strum intervals if strum is enabled.
+    // chordEvent is a copy of the trigger event, modified for each chord note sent
+    void playChord(MidiEvent& chordEvent, uint8_t velocity, uint8_t channel, uint8_t trigger) {
+        const chord_map_entry& chord = m_chordMap[trigger];
+        uint8_t count                = 0;
+        if (m_strumFrames == 0 || chord.count < 2) {
+            for (uint8_t i = 0; i < chord.count; ++i) {
+                uint32_t noteVelocity = (chord.velocity[i] * velocity) >> VELOCITY_SHIFT;
+                if (noteVelocity == 0)
+                    continue; // Zero velocity note-on would be note-off
+                if (startNote(chordEvent, channel, chord.notes[i], noteVelocity > 127 ? 127 : noteVelocity, i == 0))
+                    holdNote(channel, trigger, count++, chord.notes[i]);
+            }
+            return;
+        }
+        // Sort notes into strum order (chords are small so simple insertion sort / shuffle)
+        uint8_t order[MAX_NOTES] = {0};
+        for (uint8_t i = 1; i < chord.count; ++i) {
+            order[i] = i;
+            if (m_strumOrder == STRUM_RANDOM) {
+                m_random      = m_random * 1664525 + 1013904223;
+                uint8_t j     = (m_random >> 16) % (i + 1);
+                order[i]      = order[j];
+                order[j]      = i;
+                continue;
+            }
+            for (uint8_t j = i; j > 0 && (chord.notes[order[j - 1]] > chord.notes[order[j]]) == (m_strumOrder == STRUM_UP); --j) {
+                uint8_t swap = order[j];
+                order[j]     = order[j - 1];
+                order[j - 1] = swap;
+            }
+        }
+        uint64_t time = m_blockStart + chordEvent.frame;
+        for (uint8_t i = 0; i < chord.count; ++i) {
+            uint8_t note          = chord.notes[order[i]];
+            uint32_t noteVelocity = (chord.velocity[order[i]] * velocity) >> VELOCITY_SHIFT;
+            if (noteVelocity == 0)
+                continue; // Zero velocity note-on would be note-off
+            if (noteVelocity > 127)
+                noteVelocity = 127;
+            if (time > m_blockStart + chordEvent.frame) {
+                strum_note strum = {m_triggerGeneration[channel][trigger], chordEvent.data[0], trigger, note, (uint8_t)noteVelocity, order[i] == 0};
+                if (m_strumQueue.push(time, strum)) {
+                    time += m_strumFrames;
+                    continue;
+                }
+                // Queue full so play now
+            }
+            if (startNote(chordEvent, channel, note, noteVelocity, order[i] == 0))
+                holdNote(channel, trigger, count++, note);
+            time += m_strumFrames;
+        }
+    }
+
+    // Send strummed notes due before a time (frames since start)
+    void sendStrumNotes(uint64_t before) {
+        while (const strum_note* pending = m_strumQueue.peek(before)) {
+            strum_note strum = *pending;
+            uint64_t time    = m_strumQueue.getTime();
+            m_strumQueue.pop();
+            uint8_t channel = strum.status & 0x0F;
+            if (strum.generation != m_triggerGeneration[channel][strum.trigger])
+                continue; // Trigger released or retriggered before this note was due
+            MidiEvent chordEvent;
+            chordEvent.frame   = time - m_blockStart;
+            chordEvent.size    = 3;
+            chordEvent.data[0] = strum.status;
+            chordEvent.data[3] = 0;
+            chordEvent.dataExt = nullptr;
+            if (!startNote(chordEvent, channel, strum.note, strum.velocity, strum.root))
+                continue;
+            uint8_t* held = m_heldNotes[channel][strum.trigger];
+            uint8_t i     = 0;
+            while (i < MAX_NOTES - 1 && held[i] != 0xFF)
+                ++i;
+            holdNote(channel, strum.trigger, i, strum.note);
+        }
     }
 
     // Process audio and MIDI input.
-    void run(const float**, float**, uint32_t, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
-        int note, velocity;
+    void run(const float**, float**, uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
+        m_midiOut.flush(this); // Send events that did not fit in previous cycle
+#ifdef MULTICHORD_STATE_MAP
+        applyMapState();
+#endif
+        if (m_dirtyPitchClasses)
+            compileChordMap(); // Apply parameter changes once per block
+        m_strumFrames = m_strum * getSampleRate() / 1000;
+        m_voices.configure(this, m_midiOut, m_polyphony, m_stealPolicy);
         for (uint32_t j = 0; j < midiEventCount; ++j) {
-            if (midiEvents[j].kDataSize > 2 && (midiEvents[j].data[0] & 0xE0) == 0x80) {
-                uint8_t base_note;
+            const MidiEvent& event = midiEvents[j];
+            if (m_strumQueue.getCount())
+                sendStrumNotes(m_blockStart + event.frame);
+            if (event.size > 2 && (event.data[0] & 0xE0) == 0x80) {
                 // Note on or note off
-                for (int i = 0; i < MAX_NOTES; ++i) {
-                    // Iterate through each note of chord
-                    base_note  = midiEvents[j].data[1] % 12;
-                    int nParam = base_note * MAX_NOTES + i;
-                    int offset = m_fParamValues[nParam];
-                    if (i > 0 && offset == (int)m_fParamValues[base_note * MAX_NOTES])
-                        continue; // Skip if note not configured (same as root note)
-                    note = midiEvents[j].data[1] + offset;
-                    if (note > 127 || note < 0)
-                        continue; // Transposed note is out of range
-                    if (i)
-                        velocity = m_fParamValues[nParam + 12 * MAX_NOTES] * midiEvents[j].data[2] * m_fParamValues[m_nWet];
-                    else
-                        velocity = m_fParamValues[nParam + 12 * MAX_NOTES] * midiEvents[j].data[2];
-                    if (velocity < 0)
-                        velocity = 0;
-                    if (velocity > 127)
-                        velocity = 127;
-                    MidiEvent chordEvent;
-                    memcpy(&chordEvent, &midiEvents[j], sizeof(MidiEvent));
-                    chordEvent.data[1] = note;
-                    chordEvent.data[2] = velocity;
-                    writeMidiEvent(chordEvent);
+                uint8_t channel = event.data[0] & 0x0F;
+                uint8_t trigger = event.data[1] & 0x7F;
+                ++m_triggerGeneration[channel][trigger]; // Cancel strummed notes not yet sent
+                // Release chord previously triggered by this note (note-off or repeated note-on) using the notes it sent
+                MidiEvent chordEvent;
+                memcpy(&chordEvent, &event, sizeof(MidiEvent));
+                if (m_heldNotes[channel][trigger][0] != 0xFF)
+                    releaseChord(chordEvent, channel, trigger);
+                if ((event.data[0] & 0xF0) == 0x90 && event.data[2]) {
+                    chordEvent.data[0] = event.data[0];
+                    playChord(chordEvent, event.data[2], channel, trigger);
+                }
+            } else {
+                if (event.size > 2 && (event.data[0] & 0xF0) == 0xB0 && (event.data[1] == 120 || event.data[1] == 123)) {
+                    // All sound / notes off - forget held notes on this channel
+                    memset(m_noteRefs[event.data[0] & 0x0F], 0, sizeof(m_noteRefs[0]));
+                    memset(m_heldNotes[event.data[0] & 0x0F], 0xFF, sizeof(m_heldNotes[0]));
+                    memset(m_noteHolders[event.data[0] & 0x0F], 0, sizeof(m_noteHolders[0]));
+                    for (uint8_t trigger = 0; trigger < 128; ++trigger)
+                        ++m_triggerGeneration[event.data[0] & 0x0F][trigger];
                 }
-            } else
-                writeMidiEvent(midiEvents[j]); // Pass through unprocessed MIDI data
+                m_voices.write(this, m_midiOut, event); // Pass through unprocessed MIDI data
+            }
         }
+        if (m_strumQueue.getCount())
+            sendStrumNotes(m_blockStart + frames);
+        m_blockStart += frames;
     }
 
   private:
     float m_fParamValues[NUM_PARAMS];
     uint32_t m_nWet = NUM_PARAMS - 1;
+    chord_map_entry m_chordMap[128]; // Chord to send for each trigger note, indexed by MIDI note number
+    MidiOutQueue m_midiOut; // Events waiting for space in host output buffer
+    VoiceLimiter m_voices; // Notes sounding at output, used to enforce polyphony limit
+    uint16_t m_polyphony = 0; // Maximum quantity of notes sounding at output. 0 for unlimited
+    uint8_t m_stealPolicy = STEAL_OLDEST; // Which note is released to play a note above polyphony limit (STEAL_POLICIES)
+    uint16_t m_dirtyPitchClasses = 0xFFF; // Bitmask of pitch classes (C..B) with parameter changes not yet compiled into chord map
+    uint8_t m_noteRefs[16][128]; // Quantity of sounding chords using each note, indexed by MIDI channel and note
+    uint8_t m_heldNotes[16][128][MAX_NOTES]; // Chord notes sent for each held trigger note, indexed by MIDI channel and trigger note. 0xFF terminates list, STOLEN_NOTE marks a stolen note.
+    uint32_t m_noteHolders[16][128][4]; // Bitmap of triggers whose held chord notes include each note, indexed by MIDI channel and note
+    uint8_t m_overlap = OVERLAP_MERGE; // Policy for notes shared by overlapping chords
+    uint8_t m_preset  = 0; // Index of last loaded preset
+    float m_strum = 0.0f; // Delay between strummed chord notes in milliseconds. 0 to play all notes together
+    uint8_t m_strumOrder = STRUM_UP; // Order chord notes are strummed (STRUM_ORDERS)
+    uint16_t m_triggerGeneration[16][128]; // Incremented each time a trigger is pressed or released, indexed by MIDI channel and trigger note
+    uint32_t m_random = 1; // Pseudo random number generator state for random strum order
+    uint32_t m_strumFrames = 0; // Delay between strummed chord notes in frames, updated each run() cycle
+    uint64_t m_blockStart = 0; // Time of start of current run() cycle in frames since start
+    TimedEventQueue<strum_note, STRUM_QUEUE_SIZE> m_strumQueue; // Strummed chord notes waiting to be sent
+#ifdef MULTICHORD_STATE_MAP
+    TripleBuffer<chord_map_state> m_mapState; // Chord map parsed from state waiting for run()
+    mutable TripleBuffer<chord_map_state> m_presetMap; // Chord map loaded from preset by audio thread waiting for getState()
+    mutable chord_map_state m_stateMap; // Chord map reported by getState(). Only accessed by non-audio thread
+    uint32_t m_stateSequence   = 0; // Quantity of states set (non-audio thread)
+    uint32_t m_appliedSequence = 0; // Sequence of last state applied by audio thread
+    float m_presetPort         = 0; // Last value written to preset port
+#endif
 
     // Set our plugin class as non-copyable and add a leak detector just in case.
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MultiChord)
@@ -14,51 +14,212 @@
  */
 
 #include "DistrhoPlugin.hpp"
+#include "EnumTables.hpp"
+#include "MidiOutQueue.hpp"
+#include "VoiceLimiter.hpp"
 
 START_NAMESPACE_DISTRHO
 
 #define MAX_CHORD_NOTES 8
 
+enum CHANNEL_MODES {
+    CHANNEL_MODE_OMNI        = 0, // All MIDI channels share one tonic and set of held notes
+    CHANNEL_MODE_INDEPENDENT = 1  // Each MIDI channel has its own tonic and held notes
+};
+
+enum SCALES {
+    SCALE_IONIAN           = 0,
+    SCALE_DORIAN           = 1,
+    SCALE_PHRYGIAN         = 2,
+    SCALE_LYDIAN           = 3,
+    SCALE_MIXOLYDIAN       = 4,
+    SCALE_AEOLIAN          = 5,
+    SCALE_LOCRIAN          = 6,
+    SCALE_HARMONIC_MINOR   = 7,
+    SCALE_MELODIC_MINOR    = 8,
+    SCALE_MAJOR_PENTATONIC = 9,
+    SCALE_MINOR_PENTATONIC = 10,
+    SCALE_USER             = 11, // Scale defined by bitmask parameter
+    NUM_FIXED_SCALES       = SCALE_USER // Quantity of scales with chord tables built at compile time
+};
+
+#define NUM_USER_TABLES 2 // User scale chord tables are double buffered so held chords can be revoiced from the previous table
+
+#define DEFAULT_USER_SCALE 0xAB5 // Bitmask of C major scale (bit 0 is C)
+#define TONIC_BYPASS 255 // Tonic of a channel bypassed by a key below the tonic octave
+
+struct scale_type {
+    const char* name;
+    uint8_t size; // Quantity of notes in scale
+    uint8_t steps[12]; // Semitones of each note of scale above tonic
+};
+
+// Scales and modes. Chords are built by stacking alternate notes of the scale (thirds of heptatonic scales).
+constexpr scale_type scales[] = {
+    {"Ionian (Major)", 7, {0, 2, 4, 5, 7, 9, 11}},
+    {"Dorian", 7, {0, 2, 3, 5, 7, 9, 10}},
+    {"Phrygian", 7, {0, 1, 3, 5, 7, 8, 10}},
+    {"Lydian", 7, {0, 2, 4, 6, 7, 9, 11}},
+    {"Mixolydian", 7, {0, 2, 4, 5, 7, 9, 10}},
+    {"Aeolian (Natural Minor)", 7, {0, 2, 3, 5, 7, 8, 10}},
+    {"Locrian", 7, {0, 1, 3, 5, 6, 8, 10}},
+    {"Harmonic Minor", 7, {0, 2, 3, 5, 7, 8, 11}},
+    {"Melodic Minor", 7, {0, 2, 3, 5, 7, 9, 11}},
+    {"Major Pentatonic", 5, {0, 2, 4, 7, 9}},
+    {"Minor Pentatonic", 5, {0, 3, 5, 7, 10}}
+};
+
 struct chord_type {
     const char* name;
+    uint8_t degree; // Scale degree of chord root (0 for tonic)
+    uint8_t size; // Quantity of notes (3: triad, 4: seventh, 5: ninth)
+};
+
+// Chords selectable for each play key - names and comments relate to C tonic/root in Ionian (major) scale
+constexpr chord_type chords[] = {
+    {"None", 0, 1},
+
+    // Tonally / harmonically related
+    {"I", 0, 3}, // C major
+    {"C Major Seventh", 0, 4}, // C major seventh
+    {"III", 2, 3}, //E minor
+    {"D Minor Seventh", 1, 4}, // D minor seventh
+    {"V", 4, 3}, // G major
+    {"VII", 6, 3}, // B dimished
+    {"E Minor Seventh", 2, 4}, // E minor seventh
+    {"II", 1, 3}, //D minor
+    {"F Major Seventh", 3, 4}, // F major seventh
+    {"IV", 3, 3}, // F major
+    {"G Dominant Seventh", 4, 4}, // G dominant seventh
+    {"VI", 5, 3}, // A minor
+    {"VI7", 5, 4}, // A minor seventh
+    {"VII7", 6, 4}, // B half diminished seventh
+    {"I9", 0, 5}, // C major ninth
+    {"II9", 1, 5}, // D minor ninth
+    {"III9", 2, 5}, // E minor seventh flat ninth
+    {"IV9", 3, 5}, // F major ninth
+    {"V9", 4, 5}, // G dominant ninth
+    {"VI9", 5, 5}, // A minor ninth
+    {"VII9", 6, 5} // B half diminished seventh flat ninth
+};
+
+#define NUM_CHORDS (sizeof(chords) / sizeof(struct chord_type))
+const uint8_t numChords = NUM_CHORDS;
+
+// Notes of a chord in one key, in semitones above C of the play key's octave. 255 marks unused notes.
+struct chord_notes {
     uint8_t notes[MAX_CHORD_NOTES];
 };
 
-// Some constants
-String m_saNoteNames[] = {String("C"),  String("C#"), String("D"),  String("D#"), String("E"),  String("F"),
-                          String("F#"), String("G"),  String("G#"), String("A"),  String("A#"), String("B")};
-
-struct chord_type chords[] = {
-    {"None", {0, 255}},
-
-    // Tonally / harmonically related - comments relate to C tonic/root
-    {"I", {0, 4, 7, 255, 255, 255, 255, 255}}, // C major
-    {"C Major Seventh", {0, 4, 7, 11, 255, 255, 255, 255}}, // C major seventh
-    {"III", {4, 7, 11, 255, 255, 255, 255, 255}}, //E minor
-    {"D Minor Seventh", {2, 5, 9, 12, 255, 255, 255, 255}}, // D minor seventh
-    {"V", {7, 11, 14, 255, 255, 255, 255, 255}}, // G major
-    {"VII", {11, 14, 17, 255, 255, 255, 255, 255}}, // B dimished
-    {"E Minor Seventh", {4, 7, 11, 14, 255, 255, 255, 255}}, // E minor seventh
-    {"II", {2, 5, 9, 255, 255, 255, 255, 255}}, //D minor
-    {"F Major Seventh", {5, 9, 12, 16, 255, 255, 255, 255}}, // F major seventh
-    {"IV", {5, 9, 12, 255, 255, 255, 255, 255}}, // F major
-    {"G Dominant Seventh", {7, 11, 14, 17, 255, 255, 255, 255}}, // G dominant seventh
-    {"VI", {9, 12, 16, 255, 255, 255, 255, 255}}, // A minor
+// Notes of every chord in one key
+struct key_chords {
+    chord_notes chord[NUM_CHORDS];
+};
+
+// Chords of every key of a scale
+struct scale_chords {
+    key_chords keys[12];
+};
+
+// Chords of every key of every fixed scale
+struct scale_table {
+    scale_chords scale[NUM_FIXED_SCALES];
+};
+
+// Compile time list of indices 0..N-1 used to expand the chord tables
+template <uint32_t... I> struct index_list {};
+template <uint32_t N, uint32_t... I> struct make_index_list : make_index_list<N - 1, N - 1, I...> {};
+template <uint32_t... I> struct make_index_list<0, I...> { typedef index_list<I...> type; };
+
+// Get a note of a scale in semitones above tonic, continuing into higher octaves
+constexpr uint32_t scaleNote(uint32_t scale, uint32_t step) { return scales[scale].steps[step % scales[scale].size] + 12 * (step / scales[scale].size); }
+
+// Get a note of a chord in semitones above C or 255 if chord has fewer notes
+constexpr uint8_t chordNote(uint32_t scale, uint32_t tonic, uint32_t chord, uint32_t i) {
+    return i < chords[chord].size ? tonic + scaleNote(scale, chords[chord].degree + 2 * i) : 255;
+}
+
+template <uint32_t... N> constexpr chord_notes makeChord(uint32_t scale, uint32_t tonic, uint32_t chord, index_list<N...>) {
+    return chord_notes{{chordNote(scale, tonic, chord, N)...}};
+}
+
+template <uint32_t... C> constexpr key_chords makeKey(uint32_t scale, uint32_t tonic, index_list<C...>) {
+    return key_chords{{makeChord(scale, tonic, C, make_index_list<MAX_CHORD_NOTES>::type())...}};
+}
+
+template <uint32_t... T> constexpr scale_chords makeScale(uint32_t scale, index_list<T...>) {
+    return scale_chords{{makeKey(scale, T, make_index_list<NUM_CHORDS>::type())...}};
+}
+
+template <uint32_t... S> constexpr scale_table makeScaleTable(index_list<S...>) {
+    return scale_table{{makeScale(S, make_index_list<12>::type())...}};
+}
+
+// Notes of every chord in every key of every fixed scale, generated at compile time so that changing key or scale only selects a different table
+static constexpr scale_table SCALE_CHORDS = makeScaleTable(make_index_list<NUM_FIXED_SCALES>::type());
+
+// Engine state for a MIDI channel. Only the chord and key of each held key are stored (~520 bytes), chord notes are looked up in chord tables.
+struct channel_state {
+    uint8_t tonic; // The root note of the chord - defines the key the chord harmonies are within. TONIC_BYPASS to pass play keys through
+    const key_chords* keyChords; // Chords of current scale and tonic
+    uint8_t heldChord[128]; // Index of chord sounding for each held play key, indexed by MIDI note number. 255 if not held
+    uint8_t heldKey[128]; // Chord table * 12 + tonic of chord sounding for each held play key, indexed by MIDI note number
+    uint8_t heldVelocity[128]; // Velocity of each held play key, indexed by MIDI note number
+    uint8_t heldChannel[128]; // MIDI channel of each held play key, indexed by MIDI note number
 };
 
-uint8_t numChords = sizeof(chords)/ sizeof(struct chord_type);
+// Enumeration of chord names (excluding "None"), shared by all instances
+static const ParameterEnumerationValue* getChordEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[NUM_CHORDS - 1];
+        table() {
+            for (uint8_t i = 0; i < numChords - 1; ++i) {
+                values[i].label = chords[i + 1].name;
+                values[i].value = i + 1;
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+// Enumeration of channel modes, shared by all instances
+static const ParameterEnumerationValue* getChannelModeEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{CHANNEL_MODE_OMNI, "Omni"}, {CHANNEL_MODE_INDEPENDENT, "Independent"}};
+    return s_values;
+}
+
+// Enumeration of scales, shared by all instances
+static const ParameterEnumerationValue* getScaleEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[NUM_FIXED_SCALES + 1];
+        table() {
+            for (uint8_t i = 0; i < NUM_FIXED_SCALES; ++i) {
+                values[i].label = scales[i].name;
+                values[i].value = i;
+            }
+            values[SCALE_USER].label = "User";
+            values[SCALE_USER].value = SCALE_USER;
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
 
 // Plugin that creates different chords for each note of an octave played
 class TonalChord : public Plugin {
   public:
     TonalChord()
-        : Plugin(14, // Quantity of parameters
+        : Plugin(22, // Quantity of parameters
                  0,  // Quantity of internal presets (enable DISTRHO_PLUGIN_WANT_PROGRAMS)
                  0   // Quantity of internal states
           ) {
-            for (uint8_t i = 0; i < 128; ++i)
-                for (uint8_t j = 0; j < MAX_CHORD_NOTES; ++j)
-                    m_heldNotes[i][j] = 255;
+            memset(m_channels, 0, sizeof(m_channels));
+            for (channel_state& state : m_channels) {
+                state.keyChords = getKeyChords(m_tableRunning, 0);
+                memset(state.heldChord, 255, sizeof(state.heldChord));
+            }
+            buildUserChords(m_userChords[0], m_userScale);
           }
 
   protected:
@@ -102,23 +263,16 @@ class TonalChord : public Plugin {
 
     void initParameter(uint32_t index, Parameter& parameter) override {
         if (index < 12) {
-            String sName                            = m_saNoteNames[index] + String(" chord ");
+            String sName                            = String(NOTE_NAMES[index]) + String(" chord ");
             parameter.name                          = sName;
             parameter.symbol                        = sName.replace('#', 's').replace(' ', '_').toLower();
             parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
             parameter.ranges.min                    = 1;
             parameter.ranges.max                    = numChords - 1;
             parameter.ranges.def                    = index + 1;
-            parameter.enumValues.count              = numChords - 1;
-            parameter.enumValues.restrictedMode     = true;
             parameter.groupId                       = 0;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[numChords - 1];
-            for (uint8_t i = 0; i < numChords -1; ++i) {
-                values[i].label = chords[i + 1].name;
-                values[i].value = i + 1;
-            }
-            parameter.enumValues.values = values;
-            m_tonalChord[index] = index + 1;
+            setSharedEnumValues(parameter, getChordEnumValues(), numChords - 1);
+            m_tonalChord[index + 1] = index + 1;
         } else if (index == 12) {
             parameter.name                          = "Split Point";
             parameter.symbol                        = "split_point";
@@ -126,15 +280,8 @@ class TonalChord : public Plugin {
             parameter.ranges.min                    = 12;
             parameter.ranges.max                    = 127 - 12;
             parameter.ranges.def                    = 60;
-            parameter.enumValues.count              = 127 - 24;
-            parameter.enumValues.restrictedMode     = true;
             parameter.groupId                       = 1;
-            ParameterEnumerationValue* const values = new ParameterEnumerationValue[127 - 24];
-            for (uint8_t i = 0; i < 127 - 24; ++i) {
-                values[i].label = m_saNoteNames[i % 12] + String(i / 12 - 1);
-                values[i].value = i;
-            }
-            parameter.enumValues.values = values;
+            setSharedEnumValues(parameter, getNoteEnumValues(), 127 - 24);
         } else if (index == 13) {
             parameter.name                          = "Wet";
             parameter.symbol                        = "wet";
@@ -143,6 +290,67 @@ class TonalChord : public Plugin {
             parameter.ranges.max                    = 1.0f;
             parameter.ranges.def                    = 1.0f;
             parameter.groupId                       = 1;
+        } else if (index == 14) {
+            parameter.name                          = "Dropped Events";
+            parameter.symbol                        = "dropped";
+            parameter.hints                         = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 1000000;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 1;
+        } else if (index == 15) {
+            parameter.name                          = "Channel Mode";
+            parameter.symbol                        = "channel_mode";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = CHANNEL_MODE_OMNI;
+            parameter.ranges.max                    = CHANNEL_MODE_INDEPENDENT;
+            parameter.ranges.def                    = CHANNEL_MODE_OMNI;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getChannelModeEnumValues(), 2);
+        } else if (index == 16) {
+            parameter.name                          = "Channel Mask";
+            parameter.symbol                        = "channel_mask";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = 0xFFFF;
+            parameter.ranges.def                    = 0xFFFF;
+            parameter.groupId                       = 1;
+        } else if (index == 17) {
+            parameter.name                          = "Scale";
+            parameter.symbol                        = "scale";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = SCALE_IONIAN;
+            parameter.ranges.max                    = SCALE_USER;
+            parameter.ranges.def                    = SCALE_IONIAN;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getScaleEnumValues(), NUM_FIXED_SCALES + 1);
+        } else if (index == 18) {
+            parameter.name                          = "User Scale";
+            parameter.symbol                        = "user_scale";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 1;
+            parameter.ranges.max                    = 0xFFF;
+            parameter.ranges.def                    = DEFAULT_USER_SCALE;
+            parameter.groupId                       = 1;
+        } else if (index == 19) {
+            parameter.initDesignation(kParameterDesignationBypass);
+        } else if (index == 20) {
+            parameter.name                          = "Max Polyphony";
+            parameter.symbol                        = "max_polyphony";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = 0;
+            parameter.ranges.max                    = MAX_POLYPHONY;
+            parameter.ranges.def                    = 0;
+            parameter.groupId                       = 1;
+        } else if (index == 21) {
+            parameter.name                          = "Voice Stealing";
+            parameter.symbol                        = "voice_stealing";
+            parameter.hints                         = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min                    = STEAL_OLDEST;
+            parameter.ranges.max                    = STEAL_HIGHEST;
+            parameter.ranges.def                    = STEAL_OLDEST;
+            parameter.groupId                       = 1;
+            setSharedEnumValues(parameter, getStealPolicyEnumValues(), 3);
         }
     }
 
@@ -154,30 +362,204 @@ class TonalChord : public Plugin {
             return m_splitPoint;
         else if (index == 13)
             return m_wet;
+        else if (index == 14)
+            return m_midiOut.getDropped();
+        else if (index == 15)
+            return m_channelMode;
+        else if (index == 16)
+            return m_channelMask;
+        else if (index == 17)
+            return m_scale;
+        else if (index == 18)
+            return m_userScale;
+        else if (index == 19)
+            return m_bypass;
+        else if (index == 20)
+            return m_polyphony;
+        else if (index == 21)
+            return m_stealPolicy;
         return 0.0f;
     }
 
     // Set a control or parameter value
     void setParameterValue(uint32_t index, float value) override {
-        //!@todo All notes off then reassert relevant (held play note) chords
-        if (index < 12)
-            m_tonalChord[index + 1] = value;
+        if (index < 12) {
+            uint8_t chord = value < 1 ? 1 : value > numChords - 1 ? numChords - 1 : value; // Used to index chord tables
+            if (m_tonalChord[index + 1] != chord)
+                m_chordsChanged = true; // Held chords are revoiced by run()
+            m_tonalChord[index + 1] = chord;
+        }
         else if (index == 12 && value > 11 && value < 127 - 12)
             m_splitPoint = value;
         else if (index == 13)
             m_wet = value;
+        else if (index == 15 && value >= CHANNEL_MODE_OMNI && value <= CHANNEL_MODE_INDEPENDENT)
+            m_channelMode = value;
+        else if (index == 16 && value >= 0 && value <= 0xFFFF)
+            m_channelMask = value;
+        else if (index == 17 && value >= SCALE_IONIAN && value <= SCALE_USER)
+            m_scale = value;
+        else if (index == 18 && value >= 1 && value <= 0xFFF)
+            m_userScale = value;
+        else if (index == 19)
+            m_bypass = value > 0.5f;
+        else if (index == 20 && value >= 0 && value <= MAX_POLYPHONY)
+            m_polyphony = value;
+        else if (index == 21 && value >= STEAL_OLDEST && value <= STEAL_HIGHEST)
+            m_stealPolicy = value;
+    }
+
+    // Get the chord table of a tonic. Table is a scale index for builtin scales, SCALE_USER + buffer index for user scale.
+    const key_chords* getKeyChords(uint8_t table, uint8_t tonic) const {
+        if (table >= SCALE_USER)
+            return &m_userChords[table - SCALE_USER][tonic];
+        return &SCALE_CHORDS.scale[table].keys[tonic];
+    }
+
+    // Build the chord tables of the user scale from a bitmask of notes above tonic (bit 0 is tonic, always included)
+    void buildUserChords(key_chords* userChords, uint16_t mask) {
+        uint8_t steps[12];
+        uint8_t size = 0;
+        mask |= 1;
+        for (uint8_t i = 0; i < 12; ++i)
+            if (mask & (1 << i))
+                steps[size++] = i;
+        for (uint8_t tonic = 0; tonic < 12; ++tonic) {
+            for (uint8_t chord = 0; chord < NUM_CHORDS; ++chord) {
+                for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+                    uint8_t step = chords[chord].degree + 2 * i;
+                    userChords[tonic].chord[chord].notes[i] = i < chords[chord].size ? tonic + steps[step % size] + 12 * (step / size) : 255;
+                }
+            }
+        }
+        m_userScaleBuilt = mask;
+    }
+
+    // Apply scale and chord parameter changes, revoicing held chords. Call from audio thread before processing events.
+    void updateChords() {
+        if ((m_userScale | 1) != m_userScaleBuilt) {
+            // Build into the other buffer so that held chords can be diffed against the previous user scale
+            m_userTable ^= 1;
+            buildUserChords(m_userChords[m_userTable], m_userScale);
+        }
+        m_scaleRunning = m_scale;
+        m_tableRunning = m_scaleRunning == SCALE_USER ? SCALE_USER + m_userTable : m_scaleRunning;
+        m_chordsChanged = false;
+        for (channel_state& state : m_channels) {
+            if (state.tonic < 12)
+                state.keyChords = getKeyChords(m_tableRunning, state.tonic);
+            revoiceChords(state, 0);
+        }
+    }
+
+    void sendChordNote(uint8_t status, uint8_t note, uint8_t velocity, uint32_t frame, bool root = false) {
+        if (note > 127)
+            return;
+        MidiEvent chordEvent;
+        chordEvent.data[0] = status;
+        chordEvent.data[1] = note;
+        chordEvent.data[2] = velocity;
+        chordEvent.frame = frame;
+        chordEvent.size = 3;
+        m_voices.write(this, m_midiOut, chordEvent, root);
+    }
+
+    // Send MIDI note-off for each note of the chord held by a play key
+    void sendChordOff(channel_state& state, uint8_t note, uint32_t frame) {
+        uint8_t chordIndex = state.heldChord[note];
+        if (chordIndex >= numChords)
+            return;
+        state.heldChord[note] = 255;
+        const chord_notes& chord = getKeyChords(state.heldKey[note] / 12, state.heldKey[note] % 12)->chord[chordIndex];
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+            uint8_t offset = chord.notes[i];
+            if (offset != 255)
+                sendChordNote(0x80 | state.heldChannel[note], (note / 12) * 12 + offset, 0, frame);
+        }
+    }
+
+    // Check if a chord contains a note offset
+    static bool chordHasOffset(const chord_notes& chord, uint8_t offset) {
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i)
+            if (chord.notes[i] == offset)
+                return true;
+        return false;
+    }
+
+    // Change a held chord to the chord currently assigned to its key in the current key and scale, only sending notes that differ or were stolen
+    void revoiceChord(channel_state& state, uint8_t note, uint32_t frame) {
+        uint8_t oldChordIndex = state.heldChord[note];
+        uint8_t newChordIndex = m_tonalChord[(note % 12) + 1];
+        uint8_t newKey = m_tableRunning * 12 + state.tonic;
+        if (oldChordIndex == newChordIndex && state.heldKey[note] == newKey)
+            return;
+        const chord_notes& oldChord = getKeyChords(state.heldKey[note] / 12, state.heldKey[note] % 12)->chord[oldChordIndex];
+        const chord_notes& newChord = state.keyChords->chord[newChordIndex];
+        uint8_t octave = (note / 12) * 12;
+        uint8_t channel = state.heldChannel[note];
+        uint8_t velocity = state.heldVelocity[note];
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+            uint8_t offset = oldChord.notes[i];
+            if (offset != 255 && !chordHasOffset(newChord, offset))
+                sendChordNote(0x80 | channel, octave + offset, 0, frame);
+        }
+        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
+            uint8_t offset = newChord.notes[i];
+            if (offset != 255 && (!chordHasOffset(oldChord, offset) || m_voices.isStolen(channel, octave + offset)))
+                sendChordNote(0x90 | channel, octave + offset, i ? velocity * m_wet : velocity, frame, i == 0);
+        }
+        state.heldChord[note] = newChordIndex;
+        state.heldKey[note] = newKey;
+    }
+
+    // Revoice all chords held on a channel
+    void revoiceChords(channel_state& state, uint32_t frame) {
+        for (uint8_t note = 0; note < 128; ++note)
+            if (state.heldChord[note] < numChords)
+                revoiceChord(state, note, frame);
+    }
+
+    // Release all chords held on a channel
+    void releaseChords(channel_state& state, uint32_t frame) {
+        for (uint8_t note = 0; note < 128; ++note)
+            if (state.heldChord[note] < numChords)
+                sendChordOff(state, note, frame);
     }
 
     // Process audio and MIDI input.
     void run(const float**, float**, uint32_t, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
-        uint8_t status, note, velocity, noteOn, offset, chordNote, chordIndex;
+        uint8_t status, note, velocity, noteOn, offset, chordIndex;
         float chordVel;
+        m_midiOut.flush(this); // Send events that did not fit in previous cycle
+        if (m_bypass) {
+            // Bypassed - release held chords when entering bypass then pass all events through unprocessed
+            if (!m_bypassRunning) {
+                for (channel_state& state : m_channels)
+                    releaseChords(state, 0);
+                m_bypassRunning = true;
+            }
+            for (uint32_t j = 0; j < midiEventCount; ++j)
+                m_midiOut.write(this, midiEvents[j]);
+            return;
+        }
+        m_bypassRunning = false;
+        m_voices.configure(this, m_midiOut, m_polyphony, m_stealPolicy);
+        if (m_channelMode != m_channelModeRunning || m_channelMask != m_channelMaskRunning) {
+            // Held chords are in the engine state of the old channel mode or on a channel no longer processed
+            for (channel_state& state : m_channels)
+                releaseChords(state, 0);
+            m_channelModeRunning = m_channelMode;
+            m_channelMaskRunning = m_channelMask;
+        }
+        if (m_chordsChanged || m_scale != m_scaleRunning || (m_userScale | 1) != m_userScaleBuilt)
+            updateChords();
 
         for (uint32_t j = 0; j < midiEventCount; ++j) {
             // Iterate through each MIDI message
-            if (midiEvents[j].kDataSize > 2 && (midiEvents[j].data[0] & 0xE0) == 0x80) {
+            if (midiEvents[j].kDataSize > 2 && (midiEvents[j].data[0] & 0xE0) == 0x80 && (m_channelMaskRunning & (1 << (midiEvents[j].data[0] & 0x0f)))) {
                 // Note on/off
                 status = midiEvents[j].data[0];
+                channel_state& state = m_channels[m_channelModeRunning == CHANNEL_MODE_INDEPENDENT ? status & 0x0f : 0];
                 note = midiEvents[j].data[1];
                 velocity = midiEvents[j].data[2];
                 chordVel = velocity * m_wet;
@@ -185,74 +567,71 @@ class TonalChord : public Plugin {
 
                 if (note < m_splitPoint) {
                     // Modifier notes
-                    if (note < m_splitPoint - 12)
-                        ; //!@todo Bypass
-                    else if (noteOn)
-                        m_tonic = note - (m_splitPoint - 12);
+                    if (note < m_splitPoint - 12) {
+                        if (noteOn && state.tonic != TONIC_BYPASS) {
+                            // Bypass - release held chords and pass play keys through until a tonic is selected
+                            releaseChords(state, midiEvents[j].frame);
+                            state.tonic = TONIC_BYPASS;
+                        }
+                    } else if (noteOn && state.tonic != note - (m_splitPoint - 12)) {
+                        // Key change - move held chords to new key
+                        state.tonic = note - (m_splitPoint - 12);
+                        state.keyChords = getKeyChords(m_tableRunning, state.tonic);
+                        revoiceChords(state, midiEvents[j].frame);
+                    }
                 } else {
                     // Play notes
-                    if (noteOn) {
-                        if (m_tonic >= 12)
-                            continue; //!@todo Implement bypass
+                    if (noteOn && state.tonic == TONIC_BYPASS) {
+                        m_voices.write(this, m_midiOut, midiEvents[j]);
+                    } else if (noteOn) {
                         // Send MIDI note-off for each previously sent chord
-                        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
-                            chordNote = m_heldNotes[note][i];
-                            m_heldNotes[note][i] = 255;
-                            if (chordNote > 127)
-                                continue;
-                            MidiEvent chordEvent;
-                            memcpy(&chordEvent, &midiEvents[j], sizeof(MidiEvent));
-                            chordEvent.data[0] &= 0x8F;
-                            chordEvent.data[1] = chordNote;
-                            chordEvent.data[2] = 0;
-                            writeMidiEvent(chordEvent);
-                        }
+                        sendChordOff(state, note, midiEvents[j].frame);
                         chordIndex = m_tonalChord[(note % 12) + 1];
+                        state.heldChord[note] = chordIndex;
+                        state.heldKey[note] = m_tableRunning * 12 + state.tonic;
+                        state.heldVelocity[note] = velocity;
+                        state.heldChannel[note] = status & 0x0F;
+                        const chord_notes& chord = state.keyChords->chord[chordIndex];
                         for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
-                            offset = chords[chordIndex].notes[i];
-                            if (offset == 255)
-                                chordNote = 255;
-                            else
-                                chordNote = (note / 12) * 12 + offset + m_tonic;
-                            m_heldNotes[note][i] = chordNote;
-                            if (chordNote > 127)
-                                continue;
-                            MidiEvent chordEvent;
-                            memcpy(&chordEvent, &midiEvents[j], sizeof(MidiEvent));
-                            chordEvent.data[1] = chordNote;
-                            if (i)
-                                chordEvent.data[2] = chordVel;
-                            else
-                                chordEvent.data[2] = velocity;
-                            writeMidiEvent(chordEvent);
+                            offset = chord.notes[i];
+                            if (offset != 255)
+                                sendChordNote(status, (note / 12) * 12 + offset, i ? chordVel : velocity, midiEvents[j].frame, i == 0);
                         }
-                    } else {
+                    } else if (state.heldChord[note] < numChords) {
                         // Release note - send associated MIDI note-off messages
-                        for (uint8_t i = 0; i < MAX_CHORD_NOTES; ++i) {
-                            chordNote = m_heldNotes[note][i];
-                            m_heldNotes[note][i] = 255;
-                            if (chordNote > 127)
-                                continue;
-                            MidiEvent chordEvent;
-                            memcpy(&chordEvent, &midiEvents[j], sizeof(MidiEvent));
-                            chordEvent.data[0] &= 0x8F;
-                            chordEvent.data[1] = chordNote;
-                            chordEvent.data[2] = 0;
-                            writeMidiEvent(chordEvent);
-                        }
+                        sendChordOff(state, note, midiEvents[j].frame);
+                    } else {
+                        m_voices.write(this, m_midiOut, midiEvents[j]); // Release of note played while bypassed
                     }
                 }
             } else
-                writeMidiEvent(midiEvents[j]); // Pass through unprocessed MIDI data
+                m_voices.write(this, m_midiOut, midiEvents[j]); // Pass through unprocessed MIDI data
         }
     }
 
   private:
-    uint8_t m_tonic = 0; // The root note of the chord - defines the key the chord harmonies are within
     uint8_t m_splitPoint = 60; // MIDI note number of start of right hand (play) keys
-    uint8_t m_tonalChord[13]; // Index of the chord for each ocatave key. Index 0 is bypass (no chord)
-    uint8_t m_heldNotes[128][MAX_CHORD_NOTES]; // Currently held notes, indexed by MIDI note number. For play keys this holds the index of chord type when the key was pressed 
+    uint8_t m_tonalChord[13] = {0}; // Index of the chord for each ocatave key. Index 0 is bypass (no chord)
+    channel_state m_channels[16]; // Engine state for each MIDI channel. Only first is used in omni mode
+    uint8_t m_channelMode = CHANNEL_MODE_OMNI; // How MIDI channels share engine state (CHANNEL_MODES)
+    uint16_t m_channelMask = 0xFFFF; // Bitmask of MIDI channels processed. Other channels pass through unprocessed
+    uint8_t m_channelModeRunning = CHANNEL_MODE_OMNI; // Channel mode used by run() (follows m_channelMode at start of run() cycle)
+    uint16_t m_channelMaskRunning = 0xFFFF; // Channel mask used by run() (follows m_channelMask at start of run() cycle)
+    uint8_t m_scale = SCALE_IONIAN; // Scale or mode that chords are built from (SCALES)
+    uint8_t m_scaleRunning = SCALE_IONIAN; // Scale used by run() (follows m_scale at start of run() cycle)
+    uint8_t m_tableRunning = SCALE_IONIAN; // Chord table used by run() (scale, or SCALE_USER + m_userTable for user scale)
+    bool m_chordsChanged = false; // True if chord assignments changed since held chords were voiced
+    uint16_t m_userScale = DEFAULT_USER_SCALE; // Bitmask of notes in user scale
+    uint16_t m_userScaleBuilt = 0; // Bitmask of user scale that current user chord table was built from
+    uint8_t m_userTable = 0; // Index of current user chord table in m_userChords
+    key_chords m_userChords[NUM_USER_TABLES][12]; // Chords of every key of user scale
     float m_wet = 1.0f; // Mix of chord to root note
+    bool m_bypass = false; // True to pass all MIDI through unprocessed
+    bool m_bypassRunning = false; // True if run() has released held chords for bypass
+    uint16_t m_polyphony = 0; // Maximum quantity of notes sounding at output. 0 for unlimited
+    uint8_t m_stealPolicy = STEAL_OLDEST; // Which note is released to play a note above polyphony limit (STEAL_POLICIES)
+    VoiceLimiter m_voices; // Notes sounding at output, used to enforce polyphony limit
+    MidiOutQueue m_midiOut; // Events waiting for space in host output buffer
 
     // Set our plugin class as non-copyable and add a leak detector just in case.
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TonalChord)
@@ -0,0 +1,56 @@
+/* riban plugins - parameter enumeration tables shared by all plugin instances
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ENUM_TABLES_HPP_INCLUDED
+#define ENUM_TABLES_HPP_INCLUDED
+
+#include "DistrhoPlugin.hpp"
+
+START_NAMESPACE_DISTRHO
+
+// Note names - constant data, no static initialisation
+static const char* const NOTE_NAMES[12] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+
+/*  Enumeration tables are built on first use (thread safe function-local statics) and shared by
+    all instances of the plugin until it is unloaded. Parameters reference a shared table without
+    taking ownership so nothing is allocated or freed per instance.
+*/
+
+// Point a parameter at a shared table of enumeration values
+inline void setSharedEnumValues(Parameter& parameter, const ParameterEnumerationValue* values, uint32_t count, bool restrictedMode = true) {
+    parameter.enumValues.count          = count;
+    parameter.enumValues.restrictedMode = restrictedMode;
+    parameter.enumValues.values         = const_cast<ParameterEnumerationValue*>(values);
+    parameter.enumValues.deleteLater    = false;
+}
+
+// Table of 128 MIDI note names, e.g. "C4", valued by MIDI note number
+inline const ParameterEnumerationValue* getNoteEnumValues() {
+    struct table {
+        ParameterEnumerationValue values[128];
+        table() {
+            for (uint8_t i = 0; i < 128; ++i) {
+                values[i].label = String(NOTE_NAMES[i % 12]) + String(i / 12 - 1);
+                values[i].value = i;
+            }
+        }
+    };
+    static const table s_table;
+    return s_table.values;
+}
+
+END_NAMESPACE_DISTRHO
+
+#endif // ENUM_TABLES_HPP_INCLUDED
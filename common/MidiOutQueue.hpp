@@ -0,0 +1,81 @@
+/* riban plugins - MIDI output overflow queue
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MIDI_OUT_QUEUE_HPP_INCLUDED
+#define MIDI_OUT_QUEUE_HPP_INCLUDED
+
+#include "DistrhoPlugin.hpp"
+
+#ifndef MIDI_OUT_QUEUE_SIZE
+#define MIDI_OUT_QUEUE_SIZE 2048 // Maximum quantity of events held until next run() - enough for every key re-asserting an 8 note chord
+#endif
+
+START_NAMESPACE_DISTRHO
+
+/*  Preallocated FIFO for MIDI events that do not fit in the host's output buffer.
+    Events that the host rejects are held and sent at the start of the next run() cycle
+    (at frame 0) before any new events so that output order is preserved. Sysex (events
+    larger than MidiEvent::kDataSize) reference host memory so cannot be held and are dropped.
+*/
+class MidiOutQueue {
+  public:
+    MidiOutQueue() {}
+
+    // Send an event to the host, or queue it if the host buffer is full or older events are queued.
+    // Returns false if the event was dropped.
+    bool write(Plugin* plugin, const MidiEvent& event) {
+        if (m_count == 0 && plugin->writeMidiEvent(event))
+            return true;
+        if (m_count >= MIDI_OUT_QUEUE_SIZE || event.size > MidiEvent::kDataSize) {
+            ++m_dropped;
+            return false;
+        }
+        MidiEvent& queued = m_events[(m_head + m_count) % MIDI_OUT_QUEUE_SIZE];
+        queued            = event;
+        queued.dataExt    = nullptr;
+        ++m_count;
+        return true;
+    }
+
+    // Send queued events at frame 0. Call at start of run() before sending new events.
+    void flush(Plugin* plugin) {
+        while (m_count) {
+            MidiEvent& event = m_events[m_head];
+            event.frame      = 0;
+            if (!plugin->writeMidiEvent(event))
+                return; // Host buffer still full - retry next cycle
+            m_head = (m_head + 1) % MIDI_OUT_QUEUE_SIZE;
+            --m_count;
+        }
+    }
+
+    // Get quantity of events currently queued
+    uint32_t getQueued() const { return m_count; }
+
+    // Get quantity of events dropped since instantiation
+    uint32_t getDropped() const { return m_dropped; }
+
+  private:
+    MidiEvent m_events[MIDI_OUT_QUEUE_SIZE];
+    uint32_t m_head    = 0; // Index of oldest queued event
+    uint32_t m_count   = 0; // Quantity of queued events
+    uint32_t m_dropped = 0; // Quantity of events dropped because queue was full
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiOutQueue)
+};
+
+END_NAMESPACE_DISTRHO
+
+#endif // MIDI_OUT_QUEUE_HPP_INCLUDED
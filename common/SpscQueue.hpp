@@ -0,0 +1,60 @@
+/* riban plugins - lock-free single producer, single consumer queue
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SPSC_QUEUE_HPP_INCLUDED
+#define SPSC_QUEUE_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+
+/*  Fixed size, lock-free FIFO for passing items from one thread (producer) to another
+    (consumer), e.g. from setParameterValue() to run(). SIZE must be a power of 2.
+    Neither side allocates or blocks.
+*/
+template <typename T, uint32_t SIZE>
+class SpscQueue {
+    static_assert((SIZE & (SIZE - 1)) == 0, "SpscQueue size must be a power of 2");
+
+  public:
+    SpscQueue() : m_head(0), m_tail(0) {}
+
+    // Producer: add an item to the queue. Returns false if queue is full.
+    bool push(const T& item) {
+        uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) >= SIZE)
+            return false;
+        m_items[tail & (SIZE - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: get the oldest item without removing it. Returns null if queue is empty.
+    const T* peek() const {
+        uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return nullptr;
+        return &m_items[head & (SIZE - 1)];
+    }
+
+    // Consumer: remove the oldest item. Only call after peek() returned an item.
+    void pop() { m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  private:
+    T m_items[SIZE];
+    std::atomic<uint32_t> m_head; // Index of next item to read (written by consumer)
+    std::atomic<uint32_t> m_tail; // Index of next item to write (written by producer)
+};
+
+#endif // SPSC_QUEUE_HPP_INCLUDED
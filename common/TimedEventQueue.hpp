@@ -0,0 +1,98 @@
+/* riban plugins - fixed capacity priority queue of future events
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TIMED_EVENT_QUEUE_HPP_INCLUDED
+#define TIMED_EVENT_QUEUE_HPP_INCLUDED
+
+#include <cstdint>
+
+/*  Preallocated binary min-heap of items ordered by time (in frames since the plugin started),
+    for holding events that are due in a later run() cycle. Items due at the same time are
+    returned in the order they were pushed. push() and pop() are O(log n) and never allocate.
+    Only use from one thread (normally the audio thread).
+*/
+template <typename T, uint32_t SIZE>
+class TimedEventQueue {
+  public:
+    TimedEventQueue() {}
+
+    // Add an item due at a time. Returns false if queue is full.
+    bool push(uint64_t time, const T& item) {
+        if (m_count >= SIZE)
+            return false;
+        node added = {time, m_order++, item};
+        uint32_t i = m_count++;
+        while (i) {
+            // Sift up
+            uint32_t parent = (i - 1) / 2;
+            if (!before(added, m_nodes[parent]))
+                break;
+            m_nodes[i] = m_nodes[parent];
+            i          = parent;
+        }
+        m_nodes[i] = added;
+        return true;
+    }
+
+    // Get the earliest item if it is due before a time. Returns null if queue is empty or nothing is due.
+    const T* peek(uint64_t before) const {
+        if (m_count == 0 || m_nodes[0].time >= before)
+            return nullptr;
+        return &m_nodes[0].item;
+    }
+
+    // Get the time of the earliest item. Only call when queue is not empty.
+    uint64_t getTime() const { return m_nodes[0].time; }
+
+    // Remove the earliest item. Only call after peek() returned an item.
+    void pop() {
+        const node& last = m_nodes[--m_count];
+        uint32_t i       = 0;
+        while (true) {
+            // Sift down
+            uint32_t child = i * 2 + 1;
+            if (child >= m_count)
+                break;
+            if (child + 1 < m_count && before(m_nodes[child + 1], m_nodes[child]))
+                ++child;
+            if (!before(m_nodes[child], last))
+                break;
+            m_nodes[i] = m_nodes[child];
+            i          = child;
+        }
+        m_nodes[i] = last;
+    }
+
+    // Remove all items
+    void clear() { m_count = 0; }
+
+    // Get quantity of items waiting
+    uint32_t getCount() const { return m_count; }
+
+  private:
+    struct node {
+        uint64_t time; // Time item is due
+        uint32_t order; // Sequence number, used to keep items due at same time in push order
+        T item;
+    };
+
+    static bool before(const node& a, const node& b) { return a.time < b.time || (a.time == b.time && int32_t(a.order - b.order) < 0); }
+
+    node m_nodes[SIZE];
+    uint32_t m_count = 0; // Quantity of items in heap
+    uint32_t m_order = 0; // Sequence number of next item pushed
+};
+
+#endif // TIMED_EVENT_QUEUE_HPP_INCLUDED
@@ -0,0 +1,59 @@
+/* riban plugins - lock-free triple buffer
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TRIPLE_BUFFER_HPP_INCLUDED
+#define TRIPLE_BUFFER_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+
+/*  Passes a large value (e.g. a parsed table) from one thread (writer) to another (reader),
+    e.g. from setState() to run(). The writer fills getWriteBuffer() then calls publish(). The
+    reader calls consume() which swaps in the latest published value, if any, without copying,
+    blocking or allocating. Values published before the reader consumes them are replaced.
+*/
+template <typename T>
+class TripleBuffer {
+  public:
+    TripleBuffer() : m_ready(1) {}
+
+    // Writer: get the buffer to fill before publish()
+    T& getWriteBuffer() { return m_buffers[m_write]; }
+
+    // Writer: make the write buffer available to the reader
+    void publish() { m_write = m_ready.exchange(m_write | FRESH, std::memory_order_acq_rel) & INDEX; }
+
+    // Reader: swap in the latest published value. Returns false if nothing new was published.
+    bool consume() {
+        if (!(m_ready.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        m_read = m_ready.exchange(m_read, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // Reader: get the latest consumed value
+    const T& getReadBuffer() const { return m_buffers[m_read]; }
+
+  private:
+    static const uint8_t INDEX = 0x03; // Mask of buffer index within m_ready
+    static const uint8_t FRESH = 0x04; // Flag in m_ready indicating value not yet consumed
+
+    T m_buffers[3];
+    uint8_t m_write = 0; // Index of buffer being filled by writer
+    uint8_t m_read  = 2; // Index of buffer being used by reader
+    std::atomic<uint8_t> m_ready; // Index of latest published buffer with FRESH flag
+};
+
+#endif // TRIPLE_BUFFER_HPP_INCLUDED
@@ -0,0 +1,244 @@
+/* riban plugins - output polyphony limit with voice stealing
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef VOICE_LIMITER_HPP_INCLUDED
+#define VOICE_LIMITER_HPP_INCLUDED
+
+#include "DistrhoPlugin.hpp"
+#include "MidiOutQueue.hpp"
+
+#include <cstring>
+
+#define MAX_POLYPHONY 128 // Maximum value of polyphony limit parameter
+
+START_NAMESPACE_DISTRHO
+
+enum STEAL_POLICIES {
+    STEAL_OLDEST   = 0, // Release the voice that started first
+    STEAL_QUIETEST = 1, // Release the voice with lowest velocity (oldest of equal velocity)
+    STEAL_HIGHEST  = 2  // Release the highest pitched voice that is not a chord root (oldest voice if all are roots)
+};
+
+// Enumeration of voice stealing policies, shared by all instances
+inline const ParameterEnumerationValue* getStealPolicyEnumValues() {
+    static const ParameterEnumerationValue s_values[] = {{STEAL_OLDEST, "Oldest"}, {STEAL_QUIETEST, "Quietest"}, {STEAL_HIGHEST, "Highest non-root"}};
+    return s_values;
+}
+
+/*  Limits the quantity of notes sounding at the plugin's output. Note events are written through
+    write() which tracks each sounding voice (MIDI channel and note). When a note-on would exceed
+    the limit, a sounding voice is chosen by the stealing policy and released (note-off at the
+    same frame) first. Sounding voices are linked in lists by age, velocity and pitch with
+    bitmaps of non-empty lists so that starting, releasing and stealing a voice are O(1) and
+    never allocate. A limit of zero disables limiting and events are written unchanged.
+    A stolen voice is reported to the steal callback so that the plugin can forget it, and
+    its later note-off is discarded because the note-off has already been sent.
+    Only use from the audio thread.
+*/
+class VoiceLimiter {
+  public:
+    // Called with the MIDI channel and note of each voice released by stealing
+    typedef void (*StealCallback)(void* context, uint8_t channel, uint8_t note);
+
+    VoiceLimiter() { reset(); }
+
+    // Set function called when a voice is stolen. Call before first write().
+    void setStealCallback(StealCallback callback, void* context) {
+        m_stealCallback = callback;
+        m_stealContext  = context;
+    }
+
+    // Set polyphony limit and stealing policy, releasing voices above the limit. Call at start of run().
+    void configure(Plugin* plugin, MidiOutQueue& out, uint16_t limit, uint8_t policy) {
+        m_policy = policy;
+        if (limit == m_limit)
+            return;
+        if (limit == 0)
+            reset(); // Voices are not tracked while unlimited
+        m_limit = limit;
+        while (m_limit && m_count > m_limit)
+            steal(plugin, out, 0);
+    }
+
+    // Write an event to the output, stealing a voice if a note-on exceeds the limit.
+    // root is true if a note-on is a chord root (not stolen by STEAL_HIGHEST while other voices sound).
+    bool write(Plugin* plugin, MidiOutQueue& out, const MidiEvent& event, bool root = false) {
+        if (m_limit == 0 || event.size != 3)
+            return out.write(plugin, event);
+        uint8_t status = event.data[0] & 0xF0;
+        if (status == 0x80 || status == 0x90) {
+            uint16_t voice = ((event.data[0] & 0x0F) << 7) | (event.data[1] & 0x7F);
+            if (m_velocity[voice])
+                release(voice); // Note-off or retrigger of sounding voice
+            else if (m_stolen[voice]) {
+                m_stolen[voice] = false;
+                if (status == 0x80 || event.data[2] == 0)
+                    return true; // Note-off already sent when voice was stolen
+            }
+            if (status == 0x90 && event.data[2]) {
+                if (m_count >= m_limit)
+                    steal(plugin, out, event.frame);
+                start(voice, event.data[2], root);
+            }
+        } else if (status == 0xB0 && (event.data[1] == 120 || event.data[1] == 123)) {
+            // All sound / notes off - forget voices on this channel
+            for (uint16_t voice = (event.data[0] & 0x0F) << 7, end = voice + 128; voice < end; ++voice) {
+                if (m_velocity[voice])
+                    release(voice);
+                m_stolen[voice] = false;
+            }
+        }
+        return out.write(plugin, event);
+    }
+
+    // Forget all voices without sending note-off
+    void reset() {
+        memset(m_velocity, 0, sizeof(m_velocity));
+        memset(m_stolen, 0, sizeof(m_stolen));
+        memset(m_velocityBits, 0, sizeof(m_velocityBits));
+        memset(m_pitchBits, 0, sizeof(m_pitchBits));
+        m_age.head = m_age.tail = NO_VOICE;
+        for (uint8_t i = 0; i < 128; ++i) {
+            m_byVelocity[i].head = m_byVelocity[i].tail = NO_VOICE;
+            m_byPitch[i].head = m_byPitch[i].tail = NO_VOICE;
+        }
+        m_count = 0;
+    }
+
+    // Get quantity of voices sounding (zero when unlimited)
+    uint16_t getCount() const { return m_count; }
+
+    // Check if a note was released by stealing and has not been released or restarted by the plugin since
+    bool isStolen(uint8_t channel, uint8_t note) const { return m_stolen[((channel & 0x0F) << 7) | (note & 0x7F)]; }
+
+  private:
+    static const uint16_t NUM_VOICES = 16 * 128; // One voice per MIDI channel and note
+    static const uint16_t NO_VOICE   = 0xFFFF;
+
+    struct link {
+        uint16_t prev, next;
+    };
+
+    struct list {
+        uint16_t head, tail; // Oldest and newest voice in list
+    };
+
+    static void append(link* links, list& l, uint16_t voice) {
+        links[voice].prev = l.tail;
+        links[voice].next = NO_VOICE;
+        if (l.tail == NO_VOICE)
+            l.head = voice;
+        else
+            links[l.tail].next = voice;
+        l.tail = voice;
+    }
+
+    // Remove a voice from a list. Returns true if list is now empty.
+    static bool unlink(link* links, list& l, uint16_t voice) {
+        const link& v = links[voice];
+        if (v.prev == NO_VOICE)
+            l.head = v.next;
+        else
+            links[v.prev].next = v.next;
+        if (v.next == NO_VOICE)
+            l.tail = v.prev;
+        else
+            links[v.next].prev = v.prev;
+        return l.head == NO_VOICE;
+    }
+
+    void start(uint16_t voice, uint8_t velocity, bool root) {
+        m_velocity[voice] = velocity;
+        m_root[voice]     = root;
+        append(m_ageLinks, m_age, voice);
+        append(m_velocityLinks, m_byVelocity[velocity], voice);
+        m_velocityBits[velocity >> 5] |= 1u << (velocity & 31);
+        if (!root) {
+            uint8_t pitch = voice & 0x7F;
+            append(m_pitchLinks, m_byPitch[pitch], voice);
+            m_pitchBits[pitch >> 5] |= 1u << (pitch & 31);
+        }
+        ++m_count;
+    }
+
+    void release(uint16_t voice) {
+        uint8_t velocity = m_velocity[voice];
+        unlink(m_ageLinks, m_age, voice);
+        if (unlink(m_velocityLinks, m_byVelocity[velocity], voice))
+            m_velocityBits[velocity >> 5] &= ~(1u << (velocity & 31));
+        if (!m_root[voice]) {
+            uint8_t pitch = voice & 0x7F;
+            if (unlink(m_pitchLinks, m_byPitch[pitch], voice))
+                m_pitchBits[pitch >> 5] &= ~(1u << (pitch & 31));
+        }
+        m_velocity[voice] = 0;
+        --m_count;
+    }
+
+    // Choose a voice to steal by current policy. Only call when voices are sounding.
+    uint16_t getVictim() const {
+        if (m_policy == STEAL_QUIETEST) {
+            for (uint8_t i = 0; i < 4; ++i)
+                if (m_velocityBits[i])
+                    return m_byVelocity[i * 32 + __builtin_ctz(m_velocityBits[i])].head;
+        } else if (m_policy == STEAL_HIGHEST) {
+            for (uint8_t i = 4; i-- > 0;)
+                if (m_pitchBits[i])
+                    return m_byPitch[i * 32 + 31 - __builtin_clz(m_pitchBits[i])].head;
+        }
+        return m_age.head;
+    }
+
+    // Release a voice chosen by stealing policy, sending its note-off and reporting it to the steal callback
+    void steal(Plugin* plugin, MidiOutQueue& out, uint32_t frame) {
+        uint16_t voice = getVictim();
+        release(voice);
+        m_stolen[voice] = true;
+        MidiEvent event;
+        event.frame   = frame;
+        event.size    = 3;
+        event.data[0] = 0x80 | (voice >> 7);
+        event.data[1] = voice & 0x7F;
+        event.data[2] = 0;
+        event.data[3] = 0;
+        event.dataExt = nullptr;
+        out.write(plugin, event);
+        if (m_stealCallback)
+            m_stealCallback(m_stealContext, voice >> 7, voice & 0x7F);
+    }
+
+    uint16_t m_limit  = 0; // Maximum quantity of sounding voices. 0 for unlimited
+    uint8_t m_policy  = STEAL_OLDEST; // Voice stealing policy (STEAL_POLICIES)
+    uint16_t m_count  = 0; // Quantity of sounding voices
+    StealCallback m_stealCallback = nullptr; // Function called when a voice is stolen
+    void* m_stealContext = nullptr; // Context passed to steal callback
+    uint8_t m_velocity[NUM_VOICES]; // Velocity of each voice, indexed by channel * 128 + note. 0 if not sounding
+    bool m_root[NUM_VOICES]; // True if voice is a chord root
+    bool m_stolen[NUM_VOICES]; // True if voice was stolen and its note-off from the plugin is still expected
+    link m_ageLinks[NUM_VOICES]; // Links of sounding voices in start order
+    link m_velocityLinks[NUM_VOICES]; // Links of sounding voices with same velocity
+    link m_pitchLinks[NUM_VOICES]; // Links of sounding non-root voices with same note
+    list m_age; // All sounding voices, oldest first
+    list m_byVelocity[128]; // Sounding voices of each velocity, oldest first
+    list m_byPitch[128]; // Sounding non-root voices of each note (on any channel), oldest first
+    uint32_t m_velocityBits[4]; // Bitmap of non-empty m_byVelocity lists
+    uint32_t m_pitchBits[4]; // Bitmap of non-empty m_byPitch lists
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceLimiter)
+};
+
+END_NAMESPACE_DISTRHO
+
+#endif // VOICE_LIMITER_HPP_INCLUDED
@@ -0,0 +1,269 @@
+/* riban plugin tools - synthetic MIDI load scenarios
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Scenarios.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <strings.h>
+
+using namespace StubHost;
+
+#define SYSEX_SIZE 128
+
+// Shared sysex payload (F0 7D ... F7), referenced by each sysex event's dataExt
+static uint8_t s_sysex[SYSEX_SIZE];
+
+// Small deterministic PRNG so that streams are identical between runs and releases
+static uint32_t s_seed;
+
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525 + 1013904223;
+    return s_seed >> 8;
+}
+
+static void addEvent(EventStream& stream, uint64_t time, uint8_t status, uint8_t data1, uint8_t data2, uint32_t size = 3) {
+    if (time >= stream.duration)
+        return;
+    TimedEvent event;
+    memset(&event, 0, sizeof(event));
+    event.time          = time;
+    event.event.size    = size;
+    event.event.data[0] = status;
+    event.event.data[1] = data1;
+    event.event.data[2] = data2;
+    stream.events.push_back(event);
+}
+
+static void sortStream(EventStream& stream) {
+    std::stable_sort(stream.events.begin(), stream.events.end(), [](const TimedEvent& a, const TimedEvent& b) { return a.time < b.time; });
+}
+
+// Every 100ms press a modifier key (lower keyboard) and a six note cluster (upper keyboard), released after 80ms
+static void addChords(EventStream& stream, uint64_t start) {
+    uint32_t step = 0;
+    for (uint64_t t = start; t < stream.duration; t += 4800, ++step) {
+        uint8_t modifier = 48 + step % 12;
+        uint8_t root     = 60 + (step * 5) % 24;
+        uint8_t chan     = step % 2;
+        addEvent(stream, t, 0x90 | chan, modifier, 100);
+        for (uint8_t i = 0; i < 6; ++i)
+            addEvent(stream, t, 0x90 | chan, root + i * 3, 64 + rnd() % 63);
+        for (uint8_t i = 0; i < 6; ++i)
+            addEvent(stream, t + 3840, 0x80 | chan, root + i * 3, 0);
+        addEvent(stream, t + 3840, 0x80 | chan, modifier, 0);
+    }
+}
+
+// Legato sweep up and down the whole keyboard, one note every 2ms
+static void addGlissando(EventStream& stream, uint64_t start) {
+    int note = 21, dir = 1;
+    for (uint64_t t = start; t < stream.duration; t += 96) {
+        addEvent(stream, t, 0x90, note, 90);
+        addEvent(stream, t + 96, 0x90, note, 0); // Note-off as zero velocity note-on
+        note += dir;
+        if (note >= 108 || note <= 21)
+            dir = -dir;
+    }
+}
+
+// Continuous controller every 16 samples across all channels
+static void addCcFlood(EventStream& stream, uint64_t start, uint32_t interval) {
+    uint32_t step = 0;
+    for (uint64_t t = start; t < stream.duration; t += interval, ++step)
+        addEvent(stream, t, 0xB0 | (step % 16), 1 + step % 31, step % 128);
+}
+
+// 128 byte sysex message at an interval (samples)
+static void addSysex(EventStream& stream, uint64_t start, uint32_t interval) {
+    s_sysex[0] = 0xF0;
+    s_sysex[1] = 0x7D; // Non-commercial ID
+    for (uint32_t i = 2; i < SYSEX_SIZE - 1; ++i)
+        s_sysex[i] = i & 0x7F;
+    s_sysex[SYSEX_SIZE - 1] = 0xF7;
+    for (uint64_t t = start; t < stream.duration; t += interval) {
+        addEvent(stream, t, 0, 0, 0, SYSEX_SIZE);
+        stream.events.back().event.dataExt = s_sysex;
+    }
+}
+
+// Every play key (60..127) pressed in one frame each 100ms and held for 90ms while the modifier key (48..59) changes every 1ms
+static void addAllKeys(EventStream& stream, uint64_t start) {
+    for (uint64_t t = start; t < stream.duration; t += 4800) {
+        for (uint8_t note = 60; note < 128; ++note)
+            addEvent(stream, t, 0x90, note, 1 + rnd() % 127);
+        uint8_t modifier = 48;
+        addEvent(stream, t, 0x90, modifier, 100);
+        for (uint64_t m = t + 48; m < t + 4320; m += 48) {
+            addEvent(stream, m, 0x80, modifier, 0);
+            modifier = 48 + rnd() % 12;
+            addEvent(stream, m, 0x90, modifier, 100);
+        }
+        addEvent(stream, t + 4320, 0x80, modifier, 0);
+        for (uint8_t note = 60; note < 128; ++note)
+            addEvent(stream, t + 4320, 0x80, note, 0);
+    }
+}
+
+static void generateChords(EventStream& stream, uint64_t duration) {
+    s_seed          = 1;
+    stream.duration = duration;
+    stream.events.clear();
+    addChords(stream, 0);
+    sortStream(stream);
+}
+
+static void generateGlissando(EventStream& stream, uint64_t duration) {
+    s_seed          = 2;
+    stream.duration = duration;
+    stream.events.clear();
+    addGlissando(stream, 0);
+    sortStream(stream);
+}
+
+static void generateCcFlood(EventStream& stream, uint64_t duration) {
+    s_seed          = 3;
+    stream.duration = duration;
+    stream.events.clear();
+    addCcFlood(stream, 0, 16);
+    sortStream(stream);
+}
+
+static void generateSysex(EventStream& stream, uint64_t duration) {
+    s_seed          = 4;
+    stream.duration = duration;
+    stream.events.clear();
+    addSysex(stream, 0, 480);
+    sortStream(stream);
+}
+
+static void generateMixed(EventStream& stream, uint64_t duration) {
+    s_seed          = 5;
+    stream.duration = duration;
+    stream.events.clear();
+    addChords(stream, 0);
+    addGlissando(stream, 7);
+    addCcFlood(stream, 3, 64);
+    addSysex(stream, 11, 480);
+    sortStream(stream);
+}
+
+static void generateAllKeys(EventStream& stream, uint64_t duration) {
+    s_seed          = 6;
+    stream.duration = duration;
+    stream.events.clear();
+    addAllKeys(stream, 0);
+    sortStream(stream);
+}
+
+static void generateSysexFlood(EventStream& stream, uint64_t duration) {
+    s_seed          = 7;
+    stream.duration = duration;
+    stream.events.clear();
+    addSysex(stream, 0, 8);
+    sortStream(stream);
+}
+
+// Sweep every automatable input parameter through its range, one step per block
+static void automateAll(Instance& instance, uint64_t block, std::vector<ParameterChange>& changes) {
+    for (uint32_t i = 0; i < instance.getParameterCount(); ++i) {
+        ParameterInfo info = instance.getParameterInfo(i);
+        if (!(info.hints & PARAM_HINT_AUTOMATABLE) || (info.hints & PARAM_HINT_OUTPUT))
+            continue; // Not automatable or is output
+        ParameterChange change;
+        change.index = i;
+        change.value = info.min + (info.max - info.min) * ((block + i * 7) % 64) / 63.0f;
+        if (info.hints & PARAM_HINT_INTEGER)
+            change.value = (int)(change.value + 0.5f);
+        changes.push_back(change);
+    }
+}
+
+const Scenario g_scenarios[] = {
+    {"chords", "Modifier key plus six note cluster every 100ms", generateChords, nullptr},
+    {"glissando", "Legato sweep across the keyboard, one note every 2ms", generateGlissando, nullptr},
+    {"ccflood", "Control change every 16 samples across all channels", generateCcFlood, nullptr},
+    {"sysex", "128 byte sysex every 10ms", generateSysex, nullptr},
+    {"mixed", "Chords, glissando, controllers and sysex combined", generateMixed, nullptr},
+    {"automation", "Chords with every automatable parameter changed each block", generateChords, automateAll},
+    {"allkeys", "Every play key held with modifier changed every 1ms", generateAllKeys, nullptr},
+    {"sysexflood", "128 byte sysex every 8 samples", generateSysexFlood, nullptr}
+};
+
+const uint32_t g_scenarioCount = sizeof(g_scenarios) / sizeof(Scenario);
+
+void prepareInstance(Instance& instance, const char* pluginName) {
+    if (strcasecmp(pluginName, "MultiChord") == 0 || strcasecmp(pluginName, "MultiChordMap") == 0)
+        instance.loadProgram(5); // Major 7th on every note
+}
+
+StreamResult runStream(Instance& instance, CountingSink& sink, const Scenario& scenario, const EventStream& stream, uint32_t blockSize,
+                       std::vector<uint32_t>* blockNs) {
+    StreamResult result;
+    std::vector<MidiEvent> blockEvents;
+    std::vector<ParameterChange> changes;
+    blockEvents.reserve(4096);
+    changes.reserve(64);
+    size_t next = 0;
+    for (uint64_t blockStart = 0; blockStart < stream.duration; blockStart += blockSize) {
+        uint64_t blockEnd = blockStart + blockSize;
+        blockEvents.clear();
+        while (next < stream.events.size() && stream.events[next].time < blockEnd) {
+            MidiEvent event = stream.events[next].event;
+            event.frame     = stream.events[next].time - blockStart;
+            blockEvents.push_back(event);
+            ++next;
+        }
+        changes.clear();
+        if (scenario.automate)
+            scenario.automate(instance, result.blocks, changes);
+        sink.reset();
+        auto start = std::chrono::steady_clock::now();
+        for (const ParameterChange& change : changes)
+            instance.setParameterValue(change.index, change.value);
+        instance.run(blockSize, blockEvents.data(), blockEvents.size());
+        auto end    = std::chrono::steady_clock::now();
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        if (blockNs)
+            blockNs->push_back(ns < 0xFFFFFFFF ? ns : 0xFFFFFFFF);
+        result.totalNs += ns;
+        if (ns > result.maxNs)
+            result.maxNs = ns;
+        result.eventsIn += blockEvents.size();
+        ++result.blocks;
+    }
+    return result;
+}
+
+bool selected(const std::vector<std::string>& filter, const char* name) {
+    if (filter.empty())
+        return true;
+    for (const std::string& f : filter)
+        if (strcasecmp(f.c_str(), name) == 0)
+            return true;
+    return false;
+}
+
+void split(const char* arg, std::vector<std::string>& list) {
+    std::string s(arg);
+    size_t pos;
+    while ((pos = s.find(',')) != std::string::npos) {
+        list.push_back(s.substr(0, pos));
+        s.erase(0, pos + 1);
+    }
+    if (!s.empty())
+        list.push_back(s);
+}
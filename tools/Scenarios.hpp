@@ -0,0 +1,104 @@
+/* riban plugin tools - synthetic MIDI load scenarios and the host loop that streams them through a plugin
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SCENARIOS_HPP_INCLUDED
+#define SCENARIOS_HPP_INCLUDED
+
+#include "StubHost.hpp"
+
+#include <string>
+#include <vector>
+
+#define SAMPLE_RATE 48000.0
+
+// Block sizes tested by default
+static const uint32_t BLOCK_SIZES[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+
+// MIDI event at an absolute sample time
+struct TimedEvent {
+    uint64_t time;
+    StubHost::MidiEvent event;
+};
+
+// Deterministic stream of MIDI events, sorted by time. Independent of block size.
+struct EventStream {
+    uint64_t duration = 0; // Length of stream in samples
+    std::vector<TimedEvent> events;
+};
+
+struct ParameterChange {
+    uint32_t index;
+    float value;
+};
+
+struct Scenario {
+    const char* name;
+    const char* description;
+    // Populate stream with events for the given duration (samples)
+    void (*generate)(EventStream& stream, uint64_t duration);
+    // Optional: populate parameter changes to apply at the start of each block (null if not used)
+    void (*automate)(StubHost::Instance& instance, uint64_t block, std::vector<ParameterChange>& changes);
+};
+
+extern const Scenario g_scenarios[];
+extern const uint32_t g_scenarioCount;
+
+// Configure a new instance so that each plugin produces chords with its default scenario load
+void prepareInstance(StubHost::Instance& instance, const char* pluginName);
+
+// Output buffer with fixed capacity per block, like a host's atom sequence
+class CountingSink : public StubHost::MidiSink {
+  public:
+    explicit CountingSink(uint32_t capacity) : m_capacity(capacity) {}
+
+    bool writeMidiEvent(const StubHost::MidiEvent&) override {
+        if (m_used >= m_capacity) {
+            ++m_rejected;
+            return false;
+        }
+        ++m_used;
+        ++m_written;
+        return true;
+    }
+
+    void reset() { m_used = 0; }
+
+    uint32_t m_capacity;
+    uint32_t m_used     = 0;
+    uint64_t m_written  = 0;
+    uint64_t m_rejected = 0;
+};
+
+struct StreamResult {
+    uint64_t blocks   = 0;
+    uint64_t eventsIn = 0;
+    uint64_t totalNs  = 0; // Time of all blocks
+    uint64_t maxNs    = 0; // Time of longest block
+};
+
+/*  Pass a stream to an activated instance in blocks, applying the scenario's automation at the start of each block.
+    Each block is timed from setting automated parameters to the return of run(). If blockNs is not null, the time of
+    each block is appended to it (reserve space first so that measuring does not allocate).
+*/
+StreamResult runStream(StubHost::Instance& instance, CountingSink& sink, const Scenario& scenario, const EventStream& stream, uint32_t blockSize,
+                       std::vector<uint32_t>* blockNs = nullptr);
+
+// True if a name is in a filter list (case insensitive) or the list is empty
+bool selected(const std::vector<std::string>& filter, const char* name);
+
+// Append the items of a comma separated argument to a list
+void split(const char* arg, std::vector<std::string>& list);
+
+#endif // SCENARIOS_HPP_INCLUDED
@@ -0,0 +1,186 @@
+/* riban plugin benchmark - drives each plugin's run() with synthetic MIDI load
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Scenarios.hpp"
+#include "StubHost.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+using namespace StubHost;
+
+struct Result {
+    uint64_t blocks    = 0;
+    uint64_t eventsIn  = 0;
+    uint64_t eventsOut = 0;
+    uint64_t rejected  = 0;
+    uint64_t lost      = 0;
+    uint64_t totalNs   = 0;
+    uint64_t maxNs     = 0;
+};
+
+// Run one stream through a new plugin instance at the given block size
+static Result benchmark(const PluginEntry& plugin, const Scenario& scenario, const EventStream& stream, uint32_t blockSize, uint32_t sinkCapacity) {
+    Result result;
+    Instance* instance = plugin.create();
+    CountingSink sink(sinkCapacity);
+    instance->setMidiSink(&sink);
+    prepareInstance(*instance, plugin.name);
+    instance->activate(SAMPLE_RATE, blockSize);
+    StreamResult run = runStream(*instance, sink, scenario, stream, blockSize);
+    instance->deactivate();
+    result.blocks    = run.blocks;
+    result.eventsIn  = run.eventsIn;
+    result.totalNs   = run.totalNs;
+    result.maxNs     = run.maxNs;
+    result.eventsOut = sink.m_written;
+    result.rejected  = sink.m_rejected;
+    for (uint32_t i = 0; i < instance->getParameterCount(); ++i)
+        if (strcmp(instance->getParameterInfo(i).symbol, "dropped") == 0)
+            result.lost = instance->getParameterValue(i);
+    delete instance;
+    return result;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  -p <list>  Comma separated plugins to test (default all)\n");
+    fprintf(stderr, "  -s <list>  Comma separated scenarios to run (default all)\n");
+    fprintf(stderr, "  -b <list>  Comma separated block sizes (default 16..4096)\n");
+    fprintf(stderr, "  -d <secs>  Duration of each stream in seconds (default 10)\n");
+    fprintf(stderr, "  -r <n>     Repetitions of each test (default 3)\n");
+    fprintf(stderr, "  -c <n>     Output buffer capacity in events per block (default 65536)\n");
+    fprintf(stderr, "  -j         Output JSON lines instead of CSV\n");
+    fprintf(stderr, "  -o <file>  Write results to file (default stdout)\n");
+    fprintf(stderr, "  -l         List plugins and scenarios\n");
+    fprintf(stderr, "Plugins:");
+    for (uint32_t i = 0; i < g_pluginCount; ++i)
+        fprintf(stderr, " %s", g_plugins[i].name);
+    fprintf(stderr, "\nScenarios:");
+    for (uint32_t i = 0; i < g_scenarioCount; ++i)
+        fprintf(stderr, " %s", g_scenarios[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> pluginFilter, scenarioFilter, blockList;
+    std::vector<uint32_t> blockSizes(BLOCK_SIZES, BLOCK_SIZES + sizeof(BLOCK_SIZES) / sizeof(uint32_t));
+    double duration   = 10.0;
+    uint32_t reps     = 3;
+    uint32_t capacity = 65536;
+    bool json         = false;
+    FILE* out         = stdout;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:b:d:r:c:jo:lh")) != -1) {
+        switch (opt) {
+        case 'p':
+            split(optarg, pluginFilter);
+            break;
+        case 's':
+            split(optarg, scenarioFilter);
+            break;
+        case 'b':
+            split(optarg, blockList);
+            blockSizes.clear();
+            for (const std::string& b : blockList)
+                if (atoi(b.c_str()) > 0)
+                    blockSizes.push_back(atoi(b.c_str()));
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'c':
+            capacity = atoi(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (!out) {
+                fprintf(stderr, "Cannot open %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'l':
+            for (uint32_t i = 0; i < g_pluginCount; ++i)
+                printf("plugin %s\n", g_plugins[i].name);
+            for (uint32_t i = 0; i < g_scenarioCount; ++i)
+                printf("scenario %s: %s\n", g_scenarios[i].name, g_scenarios[i].description);
+            return 0;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (reps < 1)
+        reps = 1;
+
+    if (!json)
+        fprintf(out, "plugin,scenario,block_size,blocks,events_in,events_out,rejected,lost,total_ns,ns_per_block,ns_per_event,max_block_ns,expansion\n");
+
+    for (uint32_t s = 0; s < g_scenarioCount; ++s) {
+        const Scenario& scenario = g_scenarios[s];
+        if (!selected(scenarioFilter, scenario.name))
+            continue;
+        EventStream stream;
+        scenario.generate(stream, (uint64_t)(duration * SAMPLE_RATE));
+        for (uint32_t p = 0; p < g_pluginCount; ++p) {
+            if (!selected(pluginFilter, g_plugins[p].name))
+                continue;
+            for (uint32_t blockSize : blockSizes) {
+                Result total;
+                for (uint32_t r = 0; r < reps; ++r) {
+                    Result result = benchmark(g_plugins[p], scenario, stream, blockSize, capacity);
+                    total.blocks += result.blocks;
+                    total.eventsIn += result.eventsIn;
+                    total.eventsOut += result.eventsOut;
+                    total.rejected += result.rejected;
+                    total.lost += result.lost;
+                    total.totalNs += result.totalNs;
+                    if (result.maxNs > total.maxNs)
+                        total.maxNs = result.maxNs;
+                }
+                double nsPerBlock = total.blocks ? (double)total.totalNs / total.blocks : 0.0;
+                double nsPerEvent = total.eventsIn ? (double)total.totalNs / total.eventsIn : 0.0;
+                double expansion  = total.eventsIn ? (double)total.eventsOut / total.eventsIn : 0.0;
+                if (json)
+                    fprintf(out,
+                            "{\"plugin\":\"%s\",\"scenario\":\"%s\",\"block_size\":%u,\"blocks\":%lu,\"events_in\":%lu,\"events_out\":%lu,\"rejected\":%lu,\"lost\":%lu,"
+                            "\"total_ns\":%lu,\"ns_per_block\":%.1f,\"ns_per_event\":%.1f,\"max_block_ns\":%lu,\"expansion\":%.3f}\n",
+                            g_plugins[p].name, scenario.name, blockSize, (unsigned long)total.blocks, (unsigned long)total.eventsIn,
+                            (unsigned long)total.eventsOut, (unsigned long)total.rejected, (unsigned long)total.lost, (unsigned long)total.totalNs, nsPerBlock, nsPerEvent,
+                            (unsigned long)total.maxNs, expansion);
+                else
+                    fprintf(out, "%s,%s,%u,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%.1f,%lu,%.3f\n", g_plugins[p].name, scenario.name, blockSize,
+                            (unsigned long)total.blocks, (unsigned long)total.eventsIn, (unsigned long)total.eventsOut, (unsigned long)total.rejected,
+                            (unsigned long)total.lost,
+                            (unsigned long)total.totalNs, nsPerBlock, nsPerEvent, (unsigned long)total.maxNs, expansion);
+                fflush(out);
+            }
+        }
+    }
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
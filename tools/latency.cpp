@@ -0,0 +1,260 @@
+/* riban plugin latency - distribution of time taken by each call to a plugin's run()
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*  Times every run() call of each plugin, scenario and block size and reports percentiles and
+    a histogram so that worst case blocks, which cause xruns, are visible. The benchmark reports
+    mean load which hides these. The measuring thread is pinned to one CPU core and may be given
+    real-time priority to reduce interference from the rest of the system.
+*/
+
+#include "Scenarios.hpp"
+#include "StubHost.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+using namespace StubHost;
+
+#define HISTOGRAM_BUCKETS 32 // Power of two buckets: bucket n holds times in [2^n, 2^(n+1)) ns
+
+struct Distribution {
+    std::vector<uint32_t> samples; // Time of each run() call (ns)
+    uint64_t totalNs = 0;
+
+    // Get the time that a proportion of calls completed within
+    uint32_t getPercentile(double proportion) const {
+        if (samples.empty())
+            return 0;
+        size_t index = proportion * (samples.size() - 1) + 0.5;
+        return samples[index];
+    }
+};
+
+// Run one stream through a new plugin instance at the given block size, adding the time of each run() call to samples
+static void measure(const PluginEntry& plugin, const Scenario& scenario, const EventStream& stream, uint32_t blockSize, uint32_t sinkCapacity, Distribution* dist) {
+    Instance* instance = plugin.create();
+    CountingSink sink(sinkCapacity);
+    instance->setMidiSink(&sink);
+    prepareInstance(*instance, plugin.name);
+    instance->activate(SAMPLE_RATE, blockSize);
+    StreamResult run = runStream(*instance, sink, scenario, stream, blockSize, dist ? &dist->samples : nullptr);
+    if (dist)
+        dist->totalNs += run.totalNs;
+    instance->deactivate();
+    delete instance;
+}
+
+// Pin calling thread to a CPU core. Returns false on failure.
+static bool pinToCore(int core) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Get the highest numbered core that this process may run on (least likely to handle interrupts)
+static int getDefaultCore() {
+    cpu_set_t set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        return 0;
+    for (int core = CPU_SETSIZE - 1; core > 0; --core)
+        if (CPU_ISSET(core, &set))
+            return core;
+    return 0;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  -p <list>  Comma separated plugins to test (default all)\n");
+    fprintf(stderr, "  -s <list>  Comma separated scenarios to run (default allkeys,sysexflood,mixed,automation)\n");
+    fprintf(stderr, "  -b <list>  Comma separated block sizes (default 16..4096)\n");
+    fprintf(stderr, "  -d <secs>  Duration of each stream in seconds (default 10)\n");
+    fprintf(stderr, "  -r <n>     Repetitions of each test, after one unmeasured warm up (default 3)\n");
+    fprintf(stderr, "  -c <n>     Output buffer capacity in events per block (default 65536)\n");
+    fprintf(stderr, "  -a <core>  CPU core to run on (default highest available core, -1 to not pin)\n");
+    fprintf(stderr, "  -f <prio>  Run with SCHED_FIFO real-time priority and lock memory (may need privileges)\n");
+    fprintf(stderr, "  -t <pct>   Budget per block as percentage of block duration. Exit with error if exceeded\n");
+    fprintf(stderr, "  -H <file>  Write histograms to file as CSV\n");
+    fprintf(stderr, "  -j         Output JSON lines instead of CSV\n");
+    fprintf(stderr, "  -o <file>  Write results to file (default stdout)\n");
+    fprintf(stderr, "Plugins:");
+    for (uint32_t i = 0; i < g_pluginCount; ++i)
+        fprintf(stderr, " %s", g_plugins[i].name);
+    fprintf(stderr, "\nScenarios:");
+    for (uint32_t i = 0; i < g_scenarioCount; ++i)
+        fprintf(stderr, " %s", g_scenarios[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> pluginFilter, scenarioFilter, blockList;
+    std::vector<uint32_t> blockSizes(BLOCK_SIZES, BLOCK_SIZES + sizeof(BLOCK_SIZES) / sizeof(uint32_t));
+    double duration   = 10.0;
+    uint32_t reps     = 3;
+    uint32_t capacity = 65536;
+    int core          = getDefaultCore();
+    int priority      = 0;
+    double budget     = 0.0; // Percentage of block duration, 0 for no budget
+    bool json         = false;
+    FILE* out         = stdout;
+    FILE* histogram   = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:b:d:r:c:a:f:t:H:jo:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            split(optarg, pluginFilter);
+            break;
+        case 's':
+            split(optarg, scenarioFilter);
+            break;
+        case 'b':
+            split(optarg, blockList);
+            blockSizes.clear();
+            for (const std::string& b : blockList)
+                if (atoi(b.c_str()) > 0)
+                    blockSizes.push_back(atoi(b.c_str()));
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'c':
+            capacity = atoi(optarg);
+            break;
+        case 'a':
+            core = atoi(optarg);
+            break;
+        case 'f':
+            priority = atoi(optarg);
+            break;
+        case 't':
+            budget = atof(optarg);
+            break;
+        case 'H':
+            histogram = fopen(optarg, "w");
+            if (!histogram) {
+                fprintf(stderr, "Cannot open %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (!out) {
+                fprintf(stderr, "Cannot open %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (reps < 1)
+        reps = 1;
+    if (scenarioFilter.empty()) {
+        scenarioFilter.push_back("allkeys");
+        scenarioFilter.push_back("sysexflood");
+        scenarioFilter.push_back("mixed");
+        scenarioFilter.push_back("automation");
+    }
+
+    if (core >= 0 && !pinToCore(core))
+        fprintf(stderr, "Warning: cannot pin to core %d\n", core);
+    if (priority > 0) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+            fprintf(stderr, "Warning: cannot set real-time priority %d\n", priority);
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            fprintf(stderr, "Warning: cannot lock memory\n");
+    }
+
+    if (!json)
+        fprintf(out, "plugin,scenario,block_size,blocks,mean_ns,p50_ns,p99_ns,p999_ns,max_ns,budget_ns,over_budget\n");
+    if (histogram)
+        fprintf(histogram, "plugin,scenario,block_size,min_ns,max_ns,count\n");
+
+    bool failed = false;
+    for (uint32_t s = 0; s < g_scenarioCount; ++s) {
+        const Scenario& scenario = g_scenarios[s];
+        if (!selected(scenarioFilter, scenario.name))
+            continue;
+        EventStream stream;
+        scenario.generate(stream, (uint64_t)(duration * SAMPLE_RATE));
+        for (uint32_t p = 0; p < g_pluginCount; ++p) {
+            if (!selected(pluginFilter, g_plugins[p].name))
+                continue;
+            for (uint32_t blockSize : blockSizes) {
+                Distribution dist;
+                dist.samples.reserve((stream.duration / blockSize + 1) * reps); // Do not allocate while measuring
+                measure(g_plugins[p], scenario, stream, blockSize, capacity, nullptr); // Warm up caches and branch predictors
+                for (uint32_t r = 0; r < reps; ++r)
+                    measure(g_plugins[p], scenario, stream, blockSize, capacity, &dist);
+                std::sort(dist.samples.begin(), dist.samples.end());
+
+                uint64_t budgetNs = budget * 1e7 * blockSize / SAMPLE_RATE; // Percentage of block duration in ns
+                uint64_t over     = 0;
+                if (budgetNs) {
+                    over = dist.samples.end() - std::upper_bound(dist.samples.begin(), dist.samples.end(), budgetNs);
+                    failed |= over > 0;
+                }
+                uint64_t blocks = dist.samples.size();
+                double mean     = blocks ? (double)dist.totalNs / blocks : 0.0;
+                uint32_t max    = blocks ? dist.samples.back() : 0;
+                if (json)
+                    fprintf(out,
+                            "{\"plugin\":\"%s\",\"scenario\":\"%s\",\"block_size\":%u,\"blocks\":%lu,\"mean_ns\":%.1f,\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u,"
+                            "\"max_ns\":%u,\"budget_ns\":%lu,\"over_budget\":%lu}\n",
+                            g_plugins[p].name, scenario.name, blockSize, (unsigned long)blocks, mean, dist.getPercentile(0.5), dist.getPercentile(0.99),
+                            dist.getPercentile(0.999), max, (unsigned long)budgetNs, (unsigned long)over);
+                else
+                    fprintf(out, "%s,%s,%u,%lu,%.1f,%u,%u,%u,%u,%lu,%lu\n", g_plugins[p].name, scenario.name, blockSize, (unsigned long)blocks, mean,
+                            dist.getPercentile(0.5), dist.getPercentile(0.99), dist.getPercentile(0.999), max, (unsigned long)budgetNs, (unsigned long)over);
+                fflush(out);
+
+                if (histogram) {
+                    uint64_t counts[HISTOGRAM_BUCKETS] = {};
+                    for (uint32_t ns : dist.samples)
+                        ++counts[ns ? 31 - __builtin_clz(ns) : 0];
+                    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+                        if (counts[i])
+                            fprintf(histogram, "%s,%s,%u,%lu,%lu,%lu\n", g_plugins[p].name, scenario.name, blockSize, i ? 1ul << i : 0ul, (2ul << i) - 1,
+                                    (unsigned long)counts[i]);
+                    fflush(histogram);
+                }
+            }
+        }
+    }
+    if (out != stdout)
+        fclose(out);
+    if (histogram)
+        fclose(histogram);
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,46 @@
+/* riban headless plugin host - table of plugins
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "StubHost.hpp"
+
+#include <strings.h>
+
+// Factories exported by each plugin's StubExport.cpp
+StubHost::Instance* createMultiChord();
+StubHost::Instance* createMultiChordMap();
+StubHost::Instance* createChordulator();
+StubHost::Instance* createTonalChord();
+StubHost::Instance* createCCSend();
+
+namespace StubHost {
+
+const PluginEntry g_plugins[] = {
+    {"MultiChord", createMultiChord},
+    {"MultiChordMap", createMultiChordMap},
+    {"Chordulator", createChordulator},
+    {"TonalChord", createTonalChord},
+    {"CCSend", createCCSend}
+};
+
+const uint32_t g_pluginCount = sizeof(g_plugins) / sizeof(PluginEntry);
+
+Instance* createInstance(const char* name) {
+    for (uint32_t i = 0; i < g_pluginCount; ++i)
+        if (strcasecmp(name, g_plugins[i].name) == 0)
+            return g_plugins[i].create();
+    return nullptr;
+}
+
+} // namespace StubHost
@@ -0,0 +1,675 @@
+/* riban plugin tools - offline Standard MIDI File processor
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*  Streams Standard MIDI Files through a plugin's run() faster than real time and writes the
+    result as a format 0 SMF with the same division. Tracks are read in parallel from their own
+    file handles and merged by time so files are never loaded whole. Meta events (tempo, names,
+    etc.) bypass the plugin and are copied to the output at their original time. Blocks are
+    split at tempo changes so plugins always see the tempo of every frame they process and
+    output is the same for any block size or quantity of worker threads.
+*/
+
+#include "StubHost.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+using namespace StubHost;
+
+// Event read from or written to a SMF
+struct SmfEvent {
+    uint64_t tick; // Absolute time in SMF ticks
+    uint8_t status; // Status byte (0xFF for meta, 0xF0/0xF7 for sysex)
+    uint8_t type; // Meta event type
+    std::vector<uint8_t> data; // Data bytes following status (and type / length for meta and sysex)
+};
+
+static uint32_t readBE(const uint8_t* data, uint8_t len) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < len; ++i)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+// Reads the events of one track chunk through its own buffered file handle
+class TrackReader {
+  public:
+    ~TrackReader() {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    // Open a track chunk at an offset within a file. Returns false on failure.
+    bool open(const char* path, long offset, uint32_t length) {
+        m_file = fopen(path, "rb");
+        if (!m_file || fseek(m_file, offset, SEEK_SET) != 0)
+            return false;
+        m_remaining = length;
+        return next();
+    }
+
+    // True if the track has an event waiting in getEvent()
+    bool hasEvent() const { return m_hasEvent; }
+
+    const SmfEvent& getEvent() const { return m_event; }
+
+    // Time of end of track (valid once track is finished)
+    uint64_t getEndTick() const { return m_tick; }
+
+    // True if track data was malformed
+    bool failed() const { return m_failed; }
+
+    // Read the next event. Returns false at end of track or on error.
+    bool next() {
+        m_hasEvent = false;
+        if (m_remaining == 0 || m_ended)
+            return false;
+        uint32_t delta;
+        if (!readVlq(delta))
+            return fail();
+        m_tick += delta;
+        m_event.tick = m_tick;
+        m_event.data.clear();
+        int c = readByte();
+        if (c < 0)
+            return fail();
+        uint8_t status = c;
+        if (status < 0x80) {
+            // Running status - this byte is first data byte
+            if (m_runningStatus == 0)
+                return fail();
+            m_event.status = m_runningStatus;
+            m_event.data.push_back(status);
+            if (!readData(channelDataSize(m_runningStatus) - 1))
+                return fail();
+        } else if (status < 0xF0) {
+            m_runningStatus = status;
+            m_event.status  = status;
+            if (!readData(channelDataSize(status)))
+                return fail();
+        } else if (status == 0xFF) {
+            m_event.status = status;
+            c              = readByte();
+            uint32_t len;
+            if (c < 0 || !readVlq(len))
+                return fail();
+            m_event.type = c;
+            if (!readData(len))
+                return fail();
+            if (m_event.type == 0x2F) {
+                m_ended = true; // End of track is not returned as an event
+                return false;
+            }
+        } else if (status == 0xF0 || status == 0xF7) {
+            m_runningStatus = 0;
+            m_event.status  = status;
+            uint32_t len;
+            if (!readVlq(len) || !readData(len))
+                return fail();
+        } else {
+            return fail();
+        }
+        m_hasEvent = true;
+        return true;
+    }
+
+  private:
+    static uint8_t channelDataSize(uint8_t status) { return (status & 0xE0) == 0xC0 ? 1 : 2; }
+
+    int readByte() {
+        if (m_remaining == 0)
+            return -1;
+        --m_remaining;
+        return fgetc(m_file);
+    }
+
+    bool readData(uint32_t len) {
+        if (len > m_remaining)
+            return false;
+        size_t start = m_event.data.size();
+        m_event.data.resize(start + len);
+        m_remaining -= len;
+        return fread(m_event.data.data() + start, 1, len, m_file) == len;
+    }
+
+    bool readVlq(uint32_t& value) {
+        value = 0;
+        for (uint8_t i = 0; i < 4; ++i) {
+            int c = readByte();
+            if (c < 0)
+                return false;
+            value = (value << 7) | (c & 0x7F);
+            if (!(c & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool fail() {
+        m_failed = true;
+        return false;
+    }
+
+    FILE* m_file           = nullptr;
+    uint32_t m_remaining   = 0; // Bytes of track chunk not yet read
+    uint64_t m_tick        = 0; // Time of last event read
+    uint8_t m_runningStatus = 0;
+    bool m_hasEvent        = false;
+    bool m_ended           = false; // True if end of track meta event was read
+    bool m_failed          = false;
+    SmfEvent m_event;
+};
+
+// Writes a format 0 SMF, streaming events to file
+class SmfWriter {
+  public:
+    ~SmfWriter() {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool open(const char* path, uint16_t division) {
+        m_file = fopen(path, "wb");
+        if (!m_file)
+            return false;
+        const uint8_t header[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, (uint8_t)(division >> 8), (uint8_t)division, 'M', 'T', 'r', 'k', 0, 0, 0, 0};
+        fwrite(header, 1, sizeof(header), m_file);
+        return true;
+    }
+
+    // Write an event. Events must be written in time order.
+    void write(uint64_t tick, uint8_t status, const uint8_t* data, uint32_t len, uint8_t type = 0) {
+        if (tick < m_tick)
+            tick = m_tick;
+        writeVlq(tick - m_tick);
+        m_tick = tick;
+        putByte(status);
+        if (status == 0xFF) {
+            putByte(type);
+            writeVlq(len);
+        } else if (status == 0xF0 || status == 0xF7) {
+            writeVlq(len);
+        }
+        if (len)
+            fwrite(data, 1, len, m_file);
+        m_length += len;
+    }
+
+    // Write end of track and complete the track chunk length. Returns false on write error.
+    bool close(uint64_t endTick) {
+        write(endTick, 0xFF, nullptr, 0, 0x2F);
+        const uint8_t length[] = {(uint8_t)(m_length >> 24), (uint8_t)(m_length >> 16), (uint8_t)(m_length >> 8), (uint8_t)m_length};
+        bool ok = fseek(m_file, 18, SEEK_SET) == 0 && fwrite(length, 1, 4, m_file) == 4;
+        ok      = fclose(m_file) == 0 && ok;
+        m_file  = nullptr;
+        return ok;
+    }
+
+  private:
+    void putByte(uint8_t value) {
+        fputc(value, m_file);
+        ++m_length;
+    }
+
+    void writeVlq(uint64_t value) {
+        uint8_t bytes[5];
+        uint8_t count = 0;
+        do {
+            bytes[count++] = value & 0x7F;
+            value >>= 7;
+        } while (value && count < 5);
+        while (count--)
+            putByte(bytes[count] | (count ? 0x80 : 0));
+    }
+
+    FILE* m_file      = nullptr;
+    uint64_t m_tick   = 0; // Time of last event written
+    uint32_t m_length = 0; // Bytes written to track chunk
+};
+
+// Event written by the plugin, copied so that sysex data outlives the block
+struct OutputEvent {
+    uint64_t frame; // Absolute time in frames
+    std::vector<uint8_t> data;
+};
+
+// Collects plugin output with unlimited capacity so no events are deferred to later blocks
+class CaptureSink : public MidiSink {
+  public:
+    bool writeMidiEvent(const MidiEvent& event) override {
+        OutputEvent out;
+        out.frame          = m_blockStart + event.frame;
+        const uint8_t* src = event.size > MidiEvent::kDataSize ? event.dataExt : event.data;
+        out.data.assign(src, src + event.size);
+        m_events.push_back(out);
+        return true;
+    }
+
+    uint64_t m_blockStart = 0;
+    std::vector<OutputEvent> m_events;
+};
+
+// Maps SMF ticks to frames and back. Position is exact (fractional frames) at each tempo change so error does not accumulate.
+struct TempoMap {
+    double sampleRate;
+    uint16_t division;
+    uint64_t anchorTick  = 0; // Tick of last tempo change
+    double anchorFrame   = 0.0; // Position of last tempo change in frames
+    double framesPerTick = 0.0;
+    uint32_t tempo       = 500000; // Microseconds per quarter note
+
+    void init(double rate, uint16_t div) {
+        sampleRate = rate;
+        division   = div;
+        if (division & 0x8000) {
+            // SMPTE: frames per second (29 is 29.97 drop frame) and ticks per frame
+            int fps       = -(int8_t)(division >> 8);
+            framesPerTick = sampleRate / ((fps == 29 ? 29.97 : fps) * (division & 0xFF));
+        } else {
+            setTempo(0, tempo);
+        }
+    }
+
+    void setTempo(uint64_t tick, uint32_t usPerQuarter) {
+        if (division & 0x8000 || usPerQuarter == 0)
+            return; // Tempo does not affect SMPTE time
+        anchorFrame   = getPosition(tick);
+        anchorTick    = tick;
+        tempo         = usPerQuarter;
+        framesPerTick = sampleRate * tempo / (1000000.0 * division);
+    }
+
+    double getPosition(uint64_t tick) const { return anchorFrame + (tick - anchorTick) * framesPerTick; }
+
+    // Get the frame of a tick at or after last tempo change
+    uint64_t getFrame(uint64_t tick) const { return ceil(getPosition(tick) - 1e-6); }
+
+    // Get the position in ticks of a frame at or after last tempo change
+    double getTickPosition(uint64_t frame) const { return anchorTick + (frame - anchorFrame) / framesPerTick; }
+
+    // Get the nearest tick of a frame at or after last tempo change
+    uint64_t getTick(uint64_t frame) const { return floor(getTickPosition(frame) + 0.5); }
+};
+
+// Maps SMF ticks to bar, beat and tick from time signature meta events
+struct Meter {
+    uint16_t division;
+    uint64_t anchorTick  = 0; // Tick of last time signature change
+    uint32_t anchorBar   = 0; // Bars before last time signature change
+    uint8_t beatsPerBar  = 4;
+    uint8_t beatType     = 4;
+
+    double getBeatTicks() const { return division * 4.0 / beatType; }
+
+    void setTimeSignature(uint64_t tick, uint8_t numerator, uint8_t denominator) {
+        if (numerator == 0)
+            return;
+        anchorBar += ceil((tick - anchorTick) / (getBeatTicks() * beatsPerBar) - 1e-9); // Partial bar counts as a bar
+        anchorTick  = tick;
+        beatsPerBar = numerator;
+        beatType    = denominator;
+    }
+
+    // Set bar, beat and tick of a host time position from a position in SMF ticks
+    void getBarBeatTick(double position, TimePosition::BarBeatTick& bbt) const {
+        double beatTicks = getBeatTicks();
+        double beats     = (position - anchorTick) / beatTicks;
+        double bars      = floor(beats / beatsPerBar + 1e-9);
+        double beat      = floor(beats - bars * beatsPerBar + 1e-9);
+        bbt.valid          = true;
+        bbt.bar            = anchorBar + bars + 1;
+        bbt.beat           = beat + 1;
+        bbt.tick           = std::max(0.0, (beats - bars * beatsPerBar - beat) * beatTicks);
+        bbt.barStartTick   = anchorTick + bars * beatsPerBar * beatTicks;
+        bbt.beatsPerBar    = beatsPerBar;
+        bbt.beatType       = beatType;
+        bbt.ticksPerBeat   = beatTicks;
+    }
+};
+
+// Settings applied to each file
+struct Options {
+    const PluginEntry* plugin = nullptr;
+    uint32_t blockSize        = 256;
+    double sampleRate         = 48000.0;
+    int program               = -1;
+    std::vector<std::pair<std::string, float>> parameters; // Parameter symbol and value
+    std::vector<std::pair<std::string, std::string>> states; // State key and value
+    std::string outDir        = ".";
+};
+
+// Process one file. Returns empty string on success or description of error.
+static std::string processFile(const Options& options, const std::string& inPath, const std::string& outPath) {
+    FILE* file = fopen(inPath.c_str(), "rb");
+    if (!file)
+        return "cannot open file";
+    uint8_t header[14];
+    if (fread(header, 1, 14, file) != 14 || memcmp(header, "MThd", 4) != 0 || readBE(header + 4, 4) < 6) {
+        fclose(file);
+        return "not a Standard MIDI File";
+    }
+    uint16_t format   = readBE(header + 8, 2);
+    uint16_t numTracks = readBE(header + 10, 2);
+    uint16_t division  = readBE(header + 12, 2);
+    if (format > 1) {
+        fclose(file);
+        return "format 2 (independent sequences) not supported";
+    }
+    // Find each track chunk, skipping unknown chunks
+    std::vector<std::pair<long, uint32_t>> chunks;
+    long offset = 8 + readBE(header + 4, 4);
+    uint8_t chunkHeader[8];
+    while (chunks.size() < numTracks && fseek(file, offset, SEEK_SET) == 0 && fread(chunkHeader, 1, 8, file) == 8) {
+        uint32_t length = readBE(chunkHeader + 4, 4);
+        if (memcmp(chunkHeader, "MTrk", 4) == 0)
+            chunks.push_back(std::make_pair(offset + 8, length));
+        offset += 8 + (long)length;
+    }
+    fclose(file);
+
+    std::vector<TrackReader> tracks(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i)
+        if (!tracks[i].open(inPath.c_str(), chunks[i].first, chunks[i].second) && tracks[i].failed())
+            return "malformed track";
+
+    Instance* instance = options.plugin->create();
+    CaptureSink sink;
+    instance->setMidiSink(&sink);
+    if (options.program >= 0)
+        instance->loadProgram(options.program);
+    for (const auto& state : options.states)
+        instance->setState(state.first.c_str(), state.second.c_str());
+    for (const auto& param : options.parameters)
+        for (uint32_t i = 0; i < instance->getParameterCount(); ++i)
+            if (param.first == instance->getParameterInfo(i).symbol)
+                instance->setParameterValue(i, param.second);
+    instance->activate(options.sampleRate, options.blockSize);
+
+    SmfWriter writer;
+    if (!writer.open(outPath.c_str(), division)) {
+        delete instance;
+        return "cannot write " + outPath;
+    }
+
+    TempoMap tempoMap;
+    tempoMap.init(options.sampleRate, division);
+    Meter meter;
+    meter.division = division;
+    TimePosition timePosition;
+    memset(&timePosition, 0, sizeof(timePosition));
+    std::vector<MidiEvent> blockEvents;
+    std::vector<uint8_t> sysex; // Sysex data of this block's events
+    std::vector<std::pair<size_t, size_t>> sysexRefs; // Index of each long sysex event and offset of its data in sysex
+    std::vector<SmfEvent> metas; // Meta events to write with this block's output
+    std::vector<std::pair<uint64_t, SmfEvent>> queued; // Events for plugin with their frame, in time order. Those beyond the block are carried to the next.
+    uint64_t blockStart = 0;
+    uint64_t lastTick   = 0;
+    bool done           = false;
+    while (!done) {
+        uint64_t blockEnd = blockStart + options.blockSize;
+        blockEvents.clear();
+        sysex.clear();
+        sysexRefs.clear();
+        metas.clear();
+        while (true) {
+            // Find earliest event of all tracks (lowest track first if equal)
+            TrackReader* track = nullptr;
+            for (TrackReader& t : tracks)
+                if (t.hasEvent() && (!track || t.getEvent().tick < track->getEvent().tick))
+                    track = &t;
+            if (!track) {
+                // All tracks finished - run until end of longest track
+                uint64_t endTick = 0;
+                for (TrackReader& t : tracks)
+                    endTick = std::max(endTick, t.getEndTick());
+                uint64_t endFrame = tempoMap.getFrame(endTick);
+                if (endFrame <= blockEnd) {
+                    // Last block includes events at end of track
+                    blockEnd = std::max(endFrame, queued.empty() ? blockStart + 1 : queued.back().first + 1);
+                    done     = true;
+                }
+                break;
+            }
+            const SmfEvent& event = track->getEvent();
+            uint64_t frame        = tempoMap.getFrame(event.tick);
+            if (frame >= blockEnd)
+                break;
+            bool isTempo     = event.status == 0xFF && event.type == 0x51 && event.data.size() == 3;
+            bool isSignature = event.status == 0xFF && event.type == 0x58 && event.data.size() >= 2 && event.data[1] < 8;
+            if ((isTempo || isSignature) && frame > blockStart) {
+                blockEnd = frame; // Start new block at tempo or time signature change. Events already read at this frame are carried to it.
+                break;
+            }
+            if (isTempo)
+                tempoMap.setTempo(event.tick, readBE(event.data.data(), 3));
+            if (isSignature)
+                meter.setTimeSignature(event.tick, event.data[0], 1 << event.data[1]);
+            if (event.status == 0xFF || event.status == 0xF7)
+                metas.push_back(event); // Meta events and sysex escapes bypass plugin
+            else
+                queued.push_back(std::make_pair(frame, event));
+            if (!track->next() && track->failed()) {
+                delete instance;
+                return "malformed track";
+            }
+        }
+        // Pass events within the block to the plugin so that no event is outside the block, whatever the block size
+        size_t count = 0;
+        for (; count < queued.size() && queued[count].first < blockEnd; ++count) {
+            const SmfEvent& event = queued[count].second;
+            MidiEvent midiEvent;
+            memset(&midiEvent, 0, sizeof(midiEvent));
+            midiEvent.frame = queued[count].first - blockStart;
+            if (event.status == 0xF0) {
+                midiEvent.size = 1 + event.data.size();
+                if (midiEvent.size > MidiEvent::kDataSize) {
+                    sysexRefs.push_back(std::make_pair(blockEvents.size(), sysex.size()));
+                    sysex.push_back(0xF0);
+                    sysex.insert(sysex.end(), event.data.begin(), event.data.end());
+                } else {
+                    midiEvent.data[0] = 0xF0;
+                    memcpy(midiEvent.data + 1, event.data.data(), event.data.size());
+                }
+            } else {
+                midiEvent.size    = 1 + event.data.size();
+                midiEvent.data[0] = event.status;
+                memcpy(midiEvent.data + 1, event.data.data(), event.data.size());
+            }
+            blockEvents.push_back(midiEvent);
+        }
+        queued.erase(queued.begin(), queued.begin() + count);
+        // Point long sysex events at their data now that sysex will not reallocate
+        for (const auto& ref : sysexRefs)
+            blockEvents[ref.first].dataExt = sysex.data() + ref.second;
+
+        // Transport rolls from the start of the file. SMPTE files have no tempo so bar position is not given.
+        timePosition.playing = true;
+        timePosition.frame   = blockStart;
+        if (!(division & 0x8000)) {
+            meter.getBarBeatTick(tempoMap.getTickPosition(blockStart), timePosition.bbt);
+            timePosition.bbt.beatsPerMinute = 60000000.0 / tempoMap.tempo * meter.beatType / 4;
+        }
+        instance->setTimePosition(timePosition);
+        sink.m_blockStart = blockStart;
+        sink.m_events.clear();
+        instance->run(blockEnd - blockStart, blockEvents.data(), blockEvents.size());
+
+        // Write meta events then plugin output in time order (meta first at same tick)
+        std::stable_sort(sink.m_events.begin(), sink.m_events.end(), [](const OutputEvent& a, const OutputEvent& b) { return a.frame < b.frame; });
+        size_t m = 0;
+        for (const OutputEvent& out : sink.m_events) {
+            uint64_t tick = tempoMap.getTick(out.frame);
+            for (; m < metas.size() && metas[m].tick <= tick; ++m)
+                writer.write(metas[m].tick, metas[m].status, metas[m].data.data(), metas[m].data.size(), metas[m].type);
+            if (out.data.empty())
+                continue;
+            if (out.data[0] > 0xF0)
+                writer.write(tick, 0xF7, out.data.data(), out.data.size()); // System common and real-time as escape
+            else
+                writer.write(tick, out.data[0], out.data.data() + 1, out.data.size() - 1);
+            lastTick = std::max(lastTick, tick);
+        }
+        for (; m < metas.size(); ++m)
+            writer.write(metas[m].tick, metas[m].status, metas[m].data.data(), metas[m].data.size(), metas[m].type);
+        if (!metas.empty())
+            lastTick = std::max(lastTick, metas.back().tick);
+        blockStart = blockEnd;
+    }
+    instance->deactivate();
+    delete instance;
+
+    uint64_t endTick = lastTick;
+    for (TrackReader& t : tracks)
+        endTick = std::max(endTick, t.getEndTick());
+    if (!writer.close(endTick))
+        return "cannot write " + outPath;
+    return std::string();
+}
+
+static std::string getOutPath(const Options& options, const std::string& inPath) {
+    size_t slash = inPath.rfind('/');
+    return options.outDir + "/" + (slash == std::string::npos ? inPath : inPath.substr(slash + 1));
+}
+
+// True if two paths are the same existing file
+static bool isSameFile(const std::string& a, const std::string& b) {
+    struct stat statA, statB;
+    return stat(a.c_str(), &statA) == 0 && stat(b.c_str(), &statB) == 0 && statA.st_dev == statB.st_dev && statA.st_ino == statB.st_ino;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s -p <plugin> [options] <file.mid> ...\n", name);
+    fprintf(stderr, "  -p <name>        Plugin to process files with\n");
+    fprintf(stderr, "  -o <dir>         Directory to write processed files to (default current directory)\n");
+    fprintf(stderr, "  -b <frames>      Block size (default 256)\n");
+    fprintf(stderr, "  -r <rate>        Sample rate (default 48000)\n");
+    fprintf(stderr, "  -g <index>       Load plugin program (preset)\n");
+    fprintf(stderr, "  -s <symbol=val>  Set parameter by symbol (may be repeated)\n");
+    fprintf(stderr, "  -k <key=val>     Set plugin state (may be repeated)\n");
+    fprintf(stderr, "  -j <n>           Quantity of files processed in parallel (default all cores)\n");
+    fprintf(stderr, "Plugins:");
+    for (uint32_t i = 0; i < g_pluginCount; ++i)
+        fprintf(stderr, " %s", g_plugins[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    uint32_t jobs = std::thread::hardware_concurrency();
+    int opt;
+    while ((opt = getopt(argc, argv, "p:o:b:r:g:s:k:j:h")) != -1) {
+        const char* equals = optarg ? strchr(optarg, '=') : nullptr;
+        switch (opt) {
+        case 'p':
+            for (uint32_t i = 0; i < g_pluginCount; ++i)
+                if (strcasecmp(optarg, g_plugins[i].name) == 0)
+                    options.plugin = &g_plugins[i];
+            if (!options.plugin) {
+                fprintf(stderr, "Unknown plugin %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            options.outDir = optarg;
+            break;
+        case 'b':
+            options.blockSize = atoi(optarg);
+            break;
+        case 'r':
+            options.sampleRate = atof(optarg);
+            break;
+        case 'g':
+            options.program = atoi(optarg);
+            break;
+        case 's':
+            if (!equals) {
+                usage(argv[0]);
+                return 1;
+            }
+            options.parameters.push_back(std::make_pair(std::string(optarg, equals - optarg), (float)atof(equals + 1)));
+            break;
+        case 'k':
+            if (!equals) {
+                usage(argv[0]);
+                return 1;
+            }
+            options.states.push_back(std::make_pair(std::string(optarg, equals - optarg), std::string(equals + 1)));
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (!options.plugin || optind >= argc || options.blockSize < 1 || options.sampleRate <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::vector<std::string> files(argv + optind, argv + argc);
+    std::vector<std::string> outPaths;
+    for (const std::string& path : files) {
+        std::string outPath = getOutPath(options, path);
+        if (isSameFile(outPath, path)) {
+            fprintf(stderr, "Output would overwrite %s - choose another directory with -o\n", path.c_str());
+            return 1;
+        }
+        if (std::find(outPaths.begin(), outPaths.end(), outPath) != outPaths.end()) {
+            fprintf(stderr, "More than one file would be written to %s\n", outPath.c_str());
+            return 1;
+        }
+        outPaths.push_back(outPath);
+    }
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > files.size())
+        jobs = files.size();
+
+    // Each worker takes the next unprocessed file until all are done
+    std::atomic<uint32_t> nextFile(0);
+    std::atomic<uint32_t> failures(0);
+    std::mutex printLock;
+    auto worker = [&]() {
+        uint32_t i;
+        while ((i = nextFile++) < files.size()) {
+            std::string error = processFile(options, files[i], outPaths[i]);
+            std::lock_guard<std::mutex> lock(printLock);
+            if (error.empty()) {
+                printf("%s -> %s\n", files[i].c_str(), outPaths[i].c_str());
+            } else {
+                fprintf(stderr, "%s: %s\n", files[i].c_str(), error.c_str());
+                ++failures;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < jobs; ++i)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+    return failures ? 1 : 0;
+}
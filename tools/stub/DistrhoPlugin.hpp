@@ -0,0 +1,556 @@
+/* riban headless plugin host - minimal stand-in for DPF DistrhoPlugin.hpp
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*  Implements only the subset of the DPF plugin API used by riban plugins so that their
+    DSP may be driven by the tools in this directory without the DPF submodule or an LV2 host.
+    Plugin sources are compiled unchanged against this header.
+*/
+
+#ifndef DISTRHO_PLUGIN_HPP_INCLUDED
+#define DISTRHO_PLUGIN_HPP_INCLUDED
+
+#include "DistrhoPluginInfo.h"
+#include "StubHost.hpp"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef DISTRHO_NAMESPACE
+#define DISTRHO_NAMESPACE DISTRHO
+#endif
+
+#define START_NAMESPACE_DISTRHO namespace DISTRHO_NAMESPACE {
+#define END_NAMESPACE_DISTRHO }
+#define USE_NAMESPACE_DISTRHO using namespace DISTRHO_NAMESPACE;
+
+#ifndef DISTRHO_PLUGIN_WANT_PROGRAMS
+#define DISTRHO_PLUGIN_WANT_PROGRAMS 0
+#endif
+#ifndef DISTRHO_PLUGIN_WANT_STATE
+#define DISTRHO_PLUGIN_WANT_STATE 0
+#endif
+#ifndef DISTRHO_PLUGIN_WANT_FULL_STATE
+#define DISTRHO_PLUGIN_WANT_FULL_STATE 0
+#endif
+#ifndef DISTRHO_PLUGIN_WANT_TIMEPOS
+#define DISTRHO_PLUGIN_WANT_TIMEPOS 0
+#endif
+
+#define DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ClassName) \
+  private:                                                         \
+    ClassName(const ClassName&);                                   \
+    ClassName& operator=(const ClassName&);
+
+#define DISTRHO_SAFE_ASSERT_RETURN(cond, ret) \
+    if (!(cond)) {                            \
+        d_stderr("assertion failure: \"%s\" in file %s, line %i", #cond, __FILE__, __LINE__); \
+        return ret;                           \
+    }
+
+START_NAMESPACE_DISTRHO
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Utils
+
+static inline constexpr uint32_t d_version(const uint8_t major, const uint8_t minor, const uint8_t micro) noexcept {
+    return uint32_t(major << 16) | uint32_t(minor << 8) | uint32_t(micro << 0);
+}
+
+static inline void d_stderr(const char* const fmt, ...) noexcept {
+    va_list args;
+    va_start(args, fmt);
+    std::vfprintf(stderr, fmt, args);
+    std::fprintf(stderr, "\n");
+    va_end(args);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// String
+
+class String {
+  public:
+    String() noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) {}
+
+    String(const char* const strBuf, const bool reallocData = true) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) {
+        if (reallocData || strBuf == nullptr)
+            _dup(strBuf);
+        else {
+            fBuffer    = const_cast<char*>(strBuf);
+            fBufferLen = std::strlen(strBuf);
+        }
+    }
+
+    explicit String(const char c) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) {
+        char ch[2] = {c, '\0'};
+        _dup(ch);
+    }
+
+    explicit String(const int value) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _fmt("%d", value); }
+    explicit String(const unsigned int value) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _fmt("%u", value); }
+    explicit String(const long value) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _fmt("%ld", value); }
+    explicit String(const unsigned long value) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _fmt("%lu", value); }
+    explicit String(const float value) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _fmt("%f", value); }
+    explicit String(const double value) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _fmt("%f", value); }
+
+    String(const String& str) noexcept : fBuffer(_null()), fBufferLen(0), fBufferAlloc(false) { _dup(str.fBuffer); }
+
+    ~String() noexcept { _free(); }
+
+    std::size_t length() const noexcept { return fBufferLen; }
+    bool isEmpty() const noexcept { return fBufferLen == 0; }
+    bool isNotEmpty() const noexcept { return fBufferLen != 0; }
+    bool contains(const char* const strBuf) const noexcept { return strBuf != nullptr && std::strstr(fBuffer, strBuf) != nullptr; }
+    const char* buffer() const noexcept { return fBuffer; }
+
+    String& replace(const char before, const char after) noexcept {
+        if (before == '\0' || after == '\0')
+            return *this;
+        for (std::size_t i = 0; i < fBufferLen; ++i)
+            if (fBuffer[i] == before)
+                fBuffer[i] = after;
+        return *this;
+    }
+
+    String& toLower() noexcept {
+        for (std::size_t i = 0; i < fBufferLen; ++i)
+            if (fBuffer[i] >= 'A' && fBuffer[i] <= 'Z')
+                fBuffer[i] += 'a' - 'A';
+        return *this;
+    }
+
+    String& toUpper() noexcept {
+        for (std::size_t i = 0; i < fBufferLen; ++i)
+            if (fBuffer[i] >= 'a' && fBuffer[i] <= 'z')
+                fBuffer[i] -= 'a' - 'A';
+        return *this;
+    }
+
+    operator const char*() const noexcept { return fBuffer; }
+
+    bool operator==(const char* const strBuf) const noexcept { return strBuf != nullptr && std::strcmp(fBuffer, strBuf) == 0; }
+    bool operator==(const String& str) const noexcept { return std::strcmp(fBuffer, str.fBuffer) == 0; }
+    bool operator!=(const char* const strBuf) const noexcept { return !operator==(strBuf); }
+    bool operator!=(const String& str) const noexcept { return !operator==(str); }
+
+    String& operator=(const char* const strBuf) noexcept {
+        _dup(strBuf);
+        return *this;
+    }
+
+    String& operator=(const String& str) noexcept {
+        if (&str != this)
+            _dup(str.fBuffer);
+        return *this;
+    }
+
+    String& operator+=(const char* const strBuf) noexcept {
+        if (strBuf == nullptr || strBuf[0] == '\0')
+            return *this;
+        const std::size_t len = fBufferLen + std::strlen(strBuf);
+        char* const newBuf    = static_cast<char*>(std::malloc(len + 1));
+        std::memcpy(newBuf, fBuffer, fBufferLen);
+        std::strcpy(newBuf + fBufferLen, strBuf);
+        _free();
+        fBuffer      = newBuf;
+        fBufferLen   = len;
+        fBufferAlloc = true;
+        return *this;
+    }
+
+    String& operator+=(const String& str) noexcept { return operator+=(str.fBuffer); }
+
+    String operator+(const char* const strBuf) const noexcept {
+        String ret(*this);
+        ret += strBuf;
+        return ret;
+    }
+
+    String operator+(const String& str) const noexcept { return operator+(str.fBuffer); }
+
+  private:
+    char* fBuffer;
+    std::size_t fBufferLen;
+    bool fBufferAlloc;
+
+    static char* _null() noexcept {
+        static char sNull = '\0';
+        return &sNull;
+    }
+
+    void _free() noexcept {
+        if (fBufferAlloc)
+            std::free(fBuffer);
+        fBuffer      = _null();
+        fBufferLen   = 0;
+        fBufferAlloc = false;
+    }
+
+    void _dup(const char* const strBuf) noexcept {
+        if (strBuf == fBuffer)
+            return;
+        _free();
+        if (strBuf == nullptr || strBuf[0] == '\0')
+            return;
+        fBufferLen   = std::strlen(strBuf);
+        fBuffer      = static_cast<char*>(std::malloc(fBufferLen + 1));
+        fBufferAlloc = true;
+        std::memcpy(fBuffer, strBuf, fBufferLen + 1);
+    }
+
+    void _fmt(const char* const fmt, ...) noexcept {
+        char strBuf[64];
+        va_list args;
+        va_start(args, fmt);
+        std::vsnprintf(strBuf, sizeof(strBuf), fmt, args);
+        va_end(args);
+        _dup(strBuf);
+    }
+};
+
+static inline String operator+(const char* const strBufBefore, const String& strAfter) noexcept {
+    String ret(strBufBefore);
+    ret += strAfter;
+    return ret;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Plugin types
+
+static const uint32_t kParameterIsAutomatable  = 0x01;
+static const uint32_t kParameterIsAutomable    = kParameterIsAutomatable;
+static const uint32_t kParameterIsBoolean      = 0x02;
+static const uint32_t kParameterIsInteger      = 0x04;
+static const uint32_t kParameterIsLogarithmic  = 0x08;
+static const uint32_t kParameterIsOutput       = 0x10;
+static const uint32_t kParameterIsTrigger      = 0x20 | kParameterIsBoolean;
+static const uint32_t kParameterIsHidden       = 0x40;
+
+static const uint32_t kStateIsHostReadable     = 0x01;
+static const uint32_t kStateIsHostWritable     = 0x02 | kStateIsHostReadable;
+static const uint32_t kStateIsFilenamePath     = 0x04 | kStateIsHostWritable;
+static const uint32_t kStateIsBase64Blob       = 0x08;
+static const uint32_t kStateIsOnlyForDSP       = 0x10;
+static const uint32_t kStateIsOnlyForUI        = 0x20;
+
+static const uint32_t kPortGroupNone           = (uint32_t)-1;
+
+enum ParameterDesignation {
+    kParameterDesignationNull   = 0,
+    kParameterDesignationBypass = 1
+};
+
+typedef StubHost::MidiEvent MidiEvent;
+typedef StubHost::TimePosition TimePosition;
+
+struct ParameterRanges {
+    float def;
+    float min;
+    float max;
+
+    ParameterRanges() noexcept : def(0.0f), min(0.0f), max(1.0f) {}
+};
+
+struct ParameterEnumerationValue {
+    float value;
+    String label;
+
+    ParameterEnumerationValue() noexcept : value(0.0f), label() {}
+    ParameterEnumerationValue(float v, const char* l) noexcept : value(v), label(l) {}
+};
+
+struct ParameterEnumerationValues {
+    uint8_t count;
+    bool restrictedMode;
+    ParameterEnumerationValue* values;
+    bool deleteLater;
+
+    ParameterEnumerationValues() noexcept : count(0), restrictedMode(false), values(nullptr), deleteLater(true) {}
+
+    ~ParameterEnumerationValues() noexcept {
+        if (deleteLater)
+            delete[] values;
+        values = nullptr;
+    }
+};
+
+struct Parameter {
+    uint32_t hints;
+    String name;
+    String shortName;
+    String symbol;
+    String unit;
+    String description;
+    ParameterRanges ranges;
+    ParameterEnumerationValues enumValues;
+    ParameterDesignation designation;
+    uint8_t midiCC;
+    uint32_t groupId;
+
+    Parameter() noexcept : hints(0x0), designation(kParameterDesignationNull), midiCC(0), groupId(kPortGroupNone) {}
+
+    // Same as DPF: set up a parameter with a special host designation
+    void initDesignation(ParameterDesignation d) noexcept {
+        designation = d;
+        if (d == kParameterDesignationBypass) {
+            hints      = kParameterIsAutomatable | kParameterIsBoolean | kParameterIsInteger;
+            name       = "Bypass";
+            shortName  = "Bypass";
+            symbol     = "dpf_bypass";
+            unit       = "";
+            midiCC     = 0;
+            groupId    = kPortGroupNone;
+            ranges.def = 0.0f;
+            ranges.min = 0.0f;
+            ranges.max = 1.0f;
+        }
+    }
+};
+
+struct PortGroup {
+    String name;
+    String symbol;
+};
+
+struct State {
+    uint32_t hints;
+    String key;
+    String defaultValue;
+    String label;
+    String description;
+
+    State() noexcept : hints(0x0) {}
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Plugin
+
+class PluginExporter;
+
+class Plugin {
+  public:
+    Plugin(uint32_t parameterCount, uint32_t programCount, uint32_t stateCount)
+        : fParameterCount(parameterCount), fProgramCount(programCount), fStateCount(stateCount), fBufferSize(512), fSampleRate(48000.0),
+          fMidiSink(nullptr) {
+        std::memset(&fTimePosition, 0, sizeof(fTimePosition));
+    }
+
+    virtual ~Plugin() {}
+
+    uint32_t getBufferSize() const noexcept { return fBufferSize; }
+    double getSampleRate() const noexcept { return fSampleRate; }
+
+#if DISTRHO_PLUGIN_WANT_TIMEPOS
+    const TimePosition& getTimePosition() const noexcept { return fTimePosition; }
+#endif
+
+    bool writeMidiEvent(const MidiEvent& midiEvent) noexcept {
+        if (fMidiSink == nullptr)
+            return false;
+        return fMidiSink->writeMidiEvent(midiEvent);
+    }
+
+  protected:
+    virtual const char* getName() const { return DISTRHO_PLUGIN_NAME; }
+    virtual const char* getLabel() const = 0;
+    virtual const char* getDescription() const { return ""; }
+    virtual const char* getMaker() const = 0;
+    virtual const char* getHomePage() const { return ""; }
+    virtual const char* getLicense() const = 0;
+    virtual uint32_t getVersion() const    = 0;
+    virtual int64_t getUniqueId() const    = 0;
+
+    virtual void initParameter(uint32_t, Parameter&) {}
+    virtual void initPortGroup(uint32_t, PortGroup&) {}
+#if DISTRHO_PLUGIN_WANT_PROGRAMS
+    virtual void initProgramName(uint32_t index, String& programName) = 0;
+#endif
+#if DISTRHO_PLUGIN_WANT_STATE
+    virtual void initState(uint32_t, State&) {}
+#endif
+
+    virtual float getParameterValue(uint32_t) const { return 0.0f; }
+    virtual void setParameterValue(uint32_t, float) {}
+#if DISTRHO_PLUGIN_WANT_PROGRAMS
+    virtual void loadProgram(uint32_t index) = 0;
+#endif
+#if DISTRHO_PLUGIN_WANT_FULL_STATE
+    virtual String getState(const char*) const { return String(); }
+#endif
+#if DISTRHO_PLUGIN_WANT_STATE
+    virtual void setState(const char*, const char*) {}
+#endif
+
+    virtual void activate() {}
+    virtual void deactivate() {}
+    virtual void run(const float** inputs, float** outputs, uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) = 0;
+
+    virtual void bufferSizeChanged(uint32_t) {}
+    virtual void sampleRateChanged(double) {}
+
+  private:
+    uint32_t fParameterCount;
+    uint32_t fProgramCount;
+    uint32_t fStateCount;
+    uint32_t fBufferSize;
+    double fSampleRate;
+    TimePosition fTimePosition;
+    StubHost::MidiSink* fMidiSink;
+
+    friend class PluginExporter;
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Plugin)
+};
+
+// Plugin entry point, implemented by each plugin.
+extern Plugin* createPlugin();
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Host side wrapper, equivalent to DPF PluginExporter
+
+class PluginExporter : public StubHost::Instance {
+  public:
+    // Takes ownership of plugin. Initialises parameters, port groups and states then sets each input parameter to its default, as a host would.
+    explicit PluginExporter(Plugin* const plugin) : fPlugin(plugin), fParameters(nullptr), fStates(nullptr) {
+        if (fPlugin->fParameterCount)
+            fParameters = new Parameter[fPlugin->fParameterCount];
+        for (uint32_t i = 0; i < fPlugin->fParameterCount; ++i)
+            fPlugin->initParameter(i, fParameters[i]);
+        for (uint32_t i = 0; i < fPlugin->fParameterCount; ++i) {
+            if (fParameters[i].groupId == kPortGroupNone)
+                continue;
+            PortGroup portGroup;
+            fPlugin->initPortGroup(fParameters[i].groupId, portGroup);
+        }
+#if DISTRHO_PLUGIN_WANT_PROGRAMS
+        for (uint32_t i = 0; i < fPlugin->fProgramCount; ++i) {
+            String programName;
+            fPlugin->initProgramName(i, programName);
+        }
+#endif
+#if DISTRHO_PLUGIN_WANT_STATE
+        if (fPlugin->fStateCount)
+            fStates = new State[fPlugin->fStateCount];
+        for (uint32_t i = 0; i < fPlugin->fStateCount; ++i) {
+            fPlugin->initState(i, fStates[i]);
+            fPlugin->setState(fStates[i].key, fStates[i].defaultValue);
+        }
+#endif
+        for (uint32_t i = 0; i < fPlugin->fParameterCount; ++i) {
+            if (fParameters[i].hints & kParameterIsOutput)
+                continue;
+            fPlugin->setParameterValue(i, fParameters[i].ranges.def);
+        }
+    }
+
+    ~PluginExporter() override {
+        delete fPlugin;
+        delete[] fParameters;
+        delete[] fStates;
+    }
+
+    const char* getLabel() const override { return fPlugin->getLabel(); }
+
+    uint32_t getParameterCount() const override { return fPlugin->fParameterCount; }
+
+    StubHost::ParameterInfo getParameterInfo(uint32_t index) const override {
+        StubHost::ParameterInfo info = {"", "", 0, 0.0f, 0.0f, 0.0f};
+        if (index >= fPlugin->fParameterCount)
+            return info;
+        const Parameter& param = fParameters[index];
+        info.name              = param.name;
+        info.symbol            = param.symbol;
+        info.hints             = param.hints;
+        info.min               = param.ranges.min;
+        info.max               = param.ranges.max;
+        info.def               = param.ranges.def;
+        return info;
+    }
+
+    float getParameterValue(uint32_t index) const override { return fPlugin->getParameterValue(index); }
+
+    void setParameterValue(uint32_t index, float value) override {
+        if (index >= fPlugin->fParameterCount || (fParameters[index].hints & kParameterIsOutput))
+            return;
+        if (value < fParameters[index].ranges.min)
+            value = fParameters[index].ranges.min;
+        else if (value > fParameters[index].ranges.max)
+            value = fParameters[index].ranges.max;
+        fPlugin->setParameterValue(index, value);
+    }
+
+    uint32_t getProgramCount() const override { return fPlugin->fProgramCount; }
+
+    void loadProgram(uint32_t index) override {
+#if DISTRHO_PLUGIN_WANT_PROGRAMS
+        if (index < fPlugin->fProgramCount)
+            fPlugin->loadProgram(index);
+#else
+        (void)index;
+#endif
+    }
+
+    uint32_t getStateCount() const override { return fPlugin->fStateCount; }
+
+    const char* getStateKey(uint32_t index) const override {
+        if (fStates == nullptr || index >= fPlugin->fStateCount)
+            return "";
+        return fStates[index].key;
+    }
+
+    void setState(const char* key, const char* value) override {
+#if DISTRHO_PLUGIN_WANT_STATE
+        fPlugin->setState(key, value);
+#else
+        (void)key;
+        (void)value;
+#endif
+    }
+
+    void activate(double sampleRate, uint32_t bufferSize) override {
+        if (sampleRate != fPlugin->fSampleRate) {
+            fPlugin->fSampleRate = sampleRate;
+            fPlugin->sampleRateChanged(sampleRate);
+        }
+        if (bufferSize != fPlugin->fBufferSize) {
+            fPlugin->fBufferSize = bufferSize;
+            fPlugin->bufferSizeChanged(bufferSize);
+        }
+        fPlugin->activate();
+    }
+
+    void deactivate() override { fPlugin->deactivate(); }
+
+    void setTimePosition(const TimePosition& timePosition) override { fPlugin->fTimePosition = timePosition; }
+
+    void setMidiSink(StubHost::MidiSink* sink) override { fPlugin->fMidiSink = sink; }
+
+    void run(uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) override {
+        fPlugin->run(nullptr, nullptr, frames, midiEvents, midiEventCount);
+    }
+
+  private:
+    Plugin* const fPlugin;
+    Parameter* fParameters;
+    State* fStates;
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginExporter)
+};
+
+END_NAMESPACE_DISTRHO
+
+#endif // DISTRHO_PLUGIN_HPP_INCLUDED
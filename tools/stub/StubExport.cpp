@@ -0,0 +1,22 @@
+/* riban headless plugin host - plugin factory
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*  Compiled once per plugin, like DPF DistrhoPluginMain.cpp, with DISTRHO_NAMESPACE set to
+    the plugin's namespace and STUB_FACTORY set to the name of the exported factory function.
+*/
+
+#include "DistrhoPlugin.hpp"
+
+StubHost::Instance* STUB_FACTORY() { return new DISTRHO_NAMESPACE::PluginExporter(DISTRHO_NAMESPACE::createPlugin()); }
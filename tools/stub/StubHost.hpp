@@ -0,0 +1,115 @@
+/* riban headless plugin host - plugin format independent interface
+ * Copyright (C) 2025 Brian Walton <brian@riban.co.uk>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*  Each plugin is compiled against the stub DistrhoPlugin.hpp within its own namespace
+    (DISTRHO_NAMESPACE) so that all plugins may be linked into one executable. This file
+    holds the types shared between those namespaces and the host tools.
+*/
+
+#ifndef STUB_HOST_HPP_INCLUDED
+#define STUB_HOST_HPP_INCLUDED
+
+#include <cstdint>
+
+namespace StubHost {
+
+// Same layout as DPF MidiEvent
+struct MidiEvent {
+    static const uint32_t kDataSize = 4;
+    uint32_t frame;             // Offset of event within current block
+    uint32_t size;              // Quantity of bytes in event
+    uint8_t data[kDataSize];    // Event data if size <= kDataSize
+    const uint8_t* dataExt;     // Event data if size > kDataSize (e.g. sysex), otherwise null
+};
+
+// Same layout as DPF TimePosition
+struct TimePosition {
+    bool playing;
+    uint64_t frame;
+    struct BarBeatTick {
+        bool valid;
+        int32_t bar;
+        int32_t beat;
+        double tick;
+        double barStartTick;
+        float beatsPerBar;
+        float beatType;
+        double ticksPerBeat;
+        double beatsPerMinute;
+    } bbt;
+};
+
+// Host MIDI output buffer
+class MidiSink {
+  public:
+    virtual ~MidiSink() {}
+    // Add an event to the output buffer. Returns false if buffer is full.
+    virtual bool writeMidiEvent(const MidiEvent& event) = 0;
+};
+
+// Parameter hints (same values as DPF kParameterIs*)
+static const uint32_t PARAM_HINT_AUTOMATABLE = 0x01;
+static const uint32_t PARAM_HINT_INTEGER     = 0x04;
+static const uint32_t PARAM_HINT_OUTPUT      = 0x10;
+
+// Description of a parameter, valid for the life of the instance
+struct ParameterInfo {
+    const char* name;
+    const char* symbol;
+    uint32_t hints;
+    float min;
+    float max;
+    float def;
+};
+
+// Plugin instance as seen by the host
+class Instance {
+  public:
+    virtual ~Instance() {}
+    virtual const char* getLabel() const                            = 0;
+    virtual uint32_t getParameterCount() const                      = 0;
+    virtual ParameterInfo getParameterInfo(uint32_t index) const    = 0;
+    virtual float getParameterValue(uint32_t index) const           = 0;
+    virtual void setParameterValue(uint32_t index, float value)     = 0;
+    virtual uint32_t getProgramCount() const                        = 0;
+    virtual void loadProgram(uint32_t index)                        = 0;
+    virtual uint32_t getStateCount() const                          = 0;
+    virtual const char* getStateKey(uint32_t index) const           = 0;
+    virtual void setState(const char* key, const char* value)       = 0;
+    virtual void activate(double sampleRate, uint32_t bufferSize)   = 0;
+    virtual void deactivate()                                       = 0;
+    virtual void setTimePosition(const TimePosition& timePosition)  = 0;
+    // Set the output buffer. Events written outside run() are also sent here, like LV2 parameter updates within the host cycle.
+    virtual void setMidiSink(MidiSink* sink)                        = 0;
+    virtual void run(uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) = 0;
+};
+
+typedef Instance* (*Factory)();
+
+struct PluginEntry {
+    const char* name;
+    Factory create;
+};
+
+// Table of all plugins linked into the host (plugins.cpp)
+extern const PluginEntry g_plugins[];
+extern const uint32_t g_pluginCount;
+
+// Create an instance of the named plugin (case insensitive). Returns null if not found.
+Instance* createInstance(const char* name);
+
+} // namespace StubHost
+
+#endif // STUB_HOST_HPP_INCLUDED